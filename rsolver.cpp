@@ -3,17 +3,37 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <string>
 #include <string.h>
 #include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <memory>
 #include <iostream>
+#include <thread>
+#include <atomic>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 // Same exit codes as minisat
 // (Except we use 0 for EXIT_SATISFIABLE and they use 10)
-enum { EXIT_COMMAND_LINE_FAIL = 0, EXIT_CANNOT_READ_INPUT = 1, EXIT_CANNOT_PARSE_INPUT = 3, EXIT_SATISFIABLE = 0, EXIT_SATISFIABLE_MINISAT = 10, EXIT_UNSATISFIABLE = 20 };
+// EXIT_INTERNAL_ERROR is ours: a model that fails the final check
+enum { EXIT_COMMAND_LINE_FAIL = 0, EXIT_CANNOT_READ_INPUT = 1, EXIT_CANNOT_PARSE_INPUT = 3, EXIT_INTERNAL_ERROR = 4, EXIT_SATISFIABLE = 0, EXIT_SATISFIABLE_MINISAT = 10, EXIT_UNSATISFIABLE = 20 };
 
 static void usage() {
-	std::cerr << "Usage: rsolver '<logic-expression>'\n"
+	std::cerr << "Usage: rsolver [options] '<logic-expression>'\n"
+		"       rsolver --compile <file> -o <file.rsb>\n"
+		"       rsolver [options] <file.rsb> [[~]literal ...]\n"
 		"\n"
 		"A toy SAT (boolean SATisfiability) solver\n"
 		"https://en.wikipedia.org/wiki/Satisfiability\n"
@@ -27,15 +47,55 @@ static void usage() {
 		"~(mike & sally) & ~peter100\n"
 		"\n"
 		"The following are supported: &=and, |=or, ~=not, ()=brackets, letters=literals\n"
-		"There is no attempt at optimization or avoiding recursion\n";
+		"Word-level (bit-vector) comparisons go in braces, eg: { x:8 + y:8 == z:8 }\n"
+		"Quantifiers may prefix the formula, eg: forall a b . exists c . (a | c) & (b | ~c)\n"
+		"\n"
+		"--compile saves the parsed formula so it can be solved again without parsing,\n"
+		"optionally with extra literals assumed true (name) or false (~name)\n"
+		"The search is CDCL (conflict driven clause learning).  Options:\n"
+		"  -d, --decide vsids|vmtf|chb                  how to pick the next variable (vsids)\n"
+		"  -r, --restart none|luby|geometric|glucose    when to restart (glucose)\n"
+		"      --chrono <levels>                        backtrack one level instead of jumping\n"
+		"                                               further than this, 0 for never (100)\n"
+		"      --elim <clauses>                         eliminate variables in at most this many\n"
+		"                                               clauses of each sign first, 0 for none (16)\n"
+		"  -j, --threads <n>                            solve independent parts of the formula on\n"
+		"                                               this many threads (1)\n";
 	exit(EXIT_COMMAND_LINE_FAIL);
 }
 
 static const long KILO = 1000;
 static const long MEGA = KILO * KILO;
 static const long GIGA = MEGA * KILO;
-static long gnEvals = 0;
-static long gnMaxDepth = 0;
+
+// Per thread, so components solved in parallel do not share them; a worker
+// adds its counts to the caller's when it finishes
+static thread_local long gnConflicts = 0;
+static thread_local long gnDecisions = 0;
+static thread_local long gnPropagations = 0;
+static thread_local long gnRestarts = 0;
+static thread_local long gnDeletedClauses = 0;
+static thread_local long gnLearntLits = 0;
+static thread_local long gnMinimizedLits = 0;
+static thread_local long gnChronoBacktracks = 0;
+static thread_local long gnEliminatedVars = 0;
+static thread_local long gnSubsumedClauses = 0;
+static thread_local long gnStrengthenedLits = 0;
+static thread_local long gnEquivalentVars = 0;
+static thread_local long gnFailedLits = 0;
+static thread_local long gnNecessaryLits = 0;
+static thread_local long gnVivifiedLits = 0;
+static thread_local long gnAddedVars = 0;
+static thread_local long gnSymmetries = 0;
+static thread_local long gnTwoSatSolves = 0;
+
+// This thread's counters
+static std::vector<long *> threadCounters() {
+	return { &gnConflicts, &gnDecisions, &gnPropagations, &gnRestarts, &gnDeletedClauses, &gnLearntLits,
+		&gnMinimizedLits, &gnChronoBacktracks, &gnEliminatedVars, &gnSubsumedClauses, &gnStrengthenedLits,
+		&gnEquivalentVars, &gnFailedLits, &gnNecessaryLits, &gnVivifiedLits, &gnAddedVars, &gnSymmetries,
+		&gnTwoSatSolves };
+}
 
 //-----------------------------------------------------------------------------
 // Bool Util
@@ -44,9 +104,6 @@ inline std::string boolToString(const bool b) {
 	return b ? "True" : "False";
 }
 
-static bool gBools[] = { true, false };
-static int gnBools = sizeof(gBools) / sizeof(gBools[0]);
-
 //-----------------------------------------------------------------------------
 // String Util
 
@@ -94,10 +151,23 @@ static std::string prettyNumber(const long n) {
 	return buf;
 }
 
+// Index of name in names, or -1
+static int findName(const char *const names[], const int nNames, const std::string &name) {
+	for (int i = 0; i < nNames; i++) {
+		if (name == names[i]) return i;
+	}
+	return -1;
+}
+
 //-----------------------------------------------------------------------------
 // Parse
 
-enum TokType { TT_Unknown, TT_And, TT_Or, TT_Not, TT_Literal, TT_OpenBracket, TT_CloseBracket, TT_Space, TT_Eof };
+enum TokType { TT_Unknown, TT_And, TT_Or, TT_Not, TT_Literal, TT_OpenBracket, TT_CloseBracket, TT_Space, TT_Eof,
+	// Word-level (bit-vector) tokens, only meaningful inside { }
+	TT_OpenBrace, TT_CloseBrace, TT_Number, TT_Colon, TT_Plus, TT_Minus, TT_Xor, TT_Shl, TT_Shr,
+	TT_Eq, TT_Ne, TT_Lt, TT_Le, TT_Gt, TT_Ge,
+	// Quantifier prefix
+	TT_Forall, TT_Exists, TT_Dot };
 
 static std::string typeToString(const TokType type) {
 	switch(type) {
@@ -110,6 +180,24 @@ static std::string typeToString(const TokType type) {
 	case TT_CloseBracket: return ")";
 	case TT_Space: return "Space";	// Should never happen
 	case TT_Eof: return "Eof";
+	case TT_OpenBrace: return "{";
+	case TT_CloseBrace: return "}";
+	case TT_Number: return "Number";
+	case TT_Colon: return ":";
+	case TT_Plus: return "+";
+	case TT_Minus: return "-";
+	case TT_Xor: return "^";
+	case TT_Shl: return "<<";
+	case TT_Shr: return ">>";
+	case TT_Eq: return "==";
+	case TT_Ne: return "!=";
+	case TT_Lt: return "<";
+	case TT_Le: return "<=";
+	case TT_Gt: return ">";
+	case TT_Ge: return ">=";
+	case TT_Forall: return "forall";
+	case TT_Exists: return "exists";
+	case TT_Dot: return ".";
 	}
 	return "NotHandled";	// Should never happen
 }
@@ -124,14 +212,18 @@ public:
 
 	Token(const TokType type) {
 		mType = type;
+		mLitIndex = -1;
 	}
 
 	Token() {
 		mType = TT_Unknown;
+		mLitIndex = -1;
 	}
 
 	bool isLiteral() const { return mType == TT_Literal; }
+	bool isNumber() const { return mType == TT_Number; }
 	bool isCloseBracket() const { return mType == TT_CloseBracket; }
+	bool isCloseBrace() const { return mType == TT_CloseBrace; }
 	bool isEof() const { return mType == TT_Eof; }
 
 	TokType getType() const { return mType; }
@@ -144,7 +236,7 @@ public:
 	}
 
 	std::string toString() const {
-		if (isLiteral()) {
+		if (isLiteral() || isNumber()) {
 			return mLiteral;
 		}
 		else {
@@ -196,16 +288,71 @@ public:
 				mpPosition++;
 				return TT_CloseBracket;
 			}
+			else if (*mpPosition == '{') {
+				mpPosition++;
+				return TT_OpenBrace;
+			}
+			else if (*mpPosition == '}') {
+				mpPosition++;
+				return TT_CloseBrace;
+			}
+			else if (*mpPosition == ':') {
+				mpPosition++;
+				return TT_Colon;
+			}
+			else if (*mpPosition == '+') {
+				mpPosition++;
+				return TT_Plus;
+			}
+			else if (*mpPosition == '-') {
+				mpPosition++;
+				return TT_Minus;
+			}
+			else if (*mpPosition == '^') {
+				mpPosition++;
+				return TT_Xor;
+			}
+			else if (*mpPosition == '=' && mpPosition[1] == '=') {
+				mpPosition += 2;
+				return TT_Eq;
+			}
+			else if (*mpPosition == '!' && mpPosition[1] == '=') {
+				mpPosition += 2;
+				return TT_Ne;
+			}
+			else if (*mpPosition == '<') {
+				mpPosition++;
+				if (*mpPosition == '<') { mpPosition++; return TT_Shl; }
+				if (*mpPosition == '=') { mpPosition++; return TT_Le; }
+				return TT_Lt;
+			}
+			else if (*mpPosition == '>') {
+				mpPosition++;
+				if (*mpPosition == '>') { mpPosition++; return TT_Shr; }
+				if (*mpPosition == '=') { mpPosition++; return TT_Ge; }
+				return TT_Gt;
+			}
+			else if (isdigit(*mpPosition)) {
+				// Decimal or 0x hex -- checked when the number is used
+				tok.mType = TT_Number;
+				tok.mLiteral = *mpPosition++;
+				while (isalnum(*mpPosition)) {
+					tok.mLiteral += *mpPosition++;
+				}
+				return tok;
+			}
 			else if (isalpha(*mpPosition)) {
 				tok.mType = TT_Literal;
 				tok.mLiteral = *mpPosition++;
 				for (;;) {
-					if (!isalnum(*mpPosition)) {
-						return tok;
-					}
+					if (!isalnum(*mpPosition)) return tok;
 					tok.mLiteral += *mpPosition++;
 				}
 			}
+			else if (*mpPosition == '.') {
+				mpPosition++;
+				return TT_Dot;
+			}
 			else {
 				mpPosition++;
 				return TT_Unknown;
@@ -242,15 +389,44 @@ static std::string tokensToString(const Tokens &tokens) {
 // Literals Names and Values apart
 
 typedef std::vector<std::string> LitNames;
-typedef std::vector<bool> LitValues;
 
-inline int findLitName(const LitNames &litnames, const std::string &target) {
-	const int n = (int)litnames.size();
-	for (int i = 0; i < n; i++) {
-		if (strcmp(litnames[i].c_str(), target.c_str()) == 0) return i;
+// Name to index, so formulas with millions of literals are not O(n^2) to read
+typedef std::unordered_map<std::string, int> LitIndexes;
+
+// Looks up names that are all known already.  An open addressing table of
+// indexes into the names, so it is one allocation and no copies -- a
+// LitIndexes over the million names of a compiled file takes longer to
+// build than mapping the file does.
+class LitNameIndex {
+	const LitNames &mNames;
+	std::vector<int> mSlots;	// Index into mNames, or -1 for empty
+	size_t mMask;
+
+	size_t slotOf(const std::string &name) const {
+		return std::hash<std::string>()(name) & mMask;
 	}
-	return -1;
-}
+
+public:
+	LitNameIndex(const LitNames &names) : mNames(names) {
+		size_t nSlots = 16;
+		while (nSlots < names.size() * 2) nSlots *= 2;
+		mSlots.assign(nSlots, -1);
+		mMask = nSlots - 1;
+		for (int i = 0; i < (int)names.size(); i++) {
+			size_t slot = slotOf(names[i]);
+			while (mSlots[slot] >= 0) slot = (slot + 1) & mMask;
+			mSlots[slot] = i;
+		}
+	}
+
+	// The index of name, or -1
+	int find(const std::string &name) const {
+		for (size_t slot = slotOf(name); mSlots[slot] >= 0; slot = (slot + 1) & mMask) {
+			if (mNames[mSlots[slot]] == name) return mSlots[slot];
+		}
+		return -1;
+	}
+};
 
 static void printLitNames(const LitNames &names) {
 	std::string out;
@@ -263,427 +439,5185 @@ static void printLitNames(const LitNames &names) {
 	std::cout << "Unique Literals: " << out << std::endl;
 }
 
+// Literals inside { } are words, not booleans -- see getWordDecls()
 static void getLitNames(const Tokens &tokens, LitNames &litnames) {
+	LitIndexes indexes;
+	int braces = 0;
 	for (auto it = tokens.begin(); it != tokens.end(); it++) {
-		if (it->isLiteral()) {
-			if (findLitName(litnames, it->getLiteral()) >= 0) continue;
+		if (it->getType() == TT_OpenBrace) braces++;
+		if (it->getType() == TT_CloseBrace && braces > 0) braces--;
+		if (it->isLiteral() && braces == 0) {
+			if (!indexes.insert(std::make_pair(it->getLiteral(), (int)litnames.size())).second) continue;
 			litnames.push_back(it->getLiteral());
 		}
 	}
 }
 
 static void assignLiteralIndexes(Tokens &tokens, const LitNames &litnames) {
+	const LitNameIndex indexes(litnames);
+	int braces = 0;
 	for (auto it = tokens.begin(); it != tokens.end(); it++) {
-		if (it->isLiteral()) {
-			const int idx = findLitName(litnames, it->getLiteral());
-			if (idx < 0) continue;
-			it->setLitIndex(idx);
+		if (it->getType() == TT_OpenBrace) braces++;
+		if (it->getType() == TT_CloseBrace && braces > 0) braces--;
+		if (it->isLiteral() && braces == 0) {
+			const int idx = indexes.find(it->getLiteral());
+			if (idx >= 0) it->setLitIndex(idx);
 		}
 	}
 }
 
 //-----------------------------------------------------------------------------
-// Working Literal Values
+// Literal Values
+// Each literal is true, false or unassigned, one byte per literal so the hot
+// path reads them directly with no bit proxies.  The array is cache line
+// aligned and padded to whole cache lines so it can be cleared and copied
+// with SIMD.
 
-class WorkingValues {
-	const LitNames	*mpNames; // This is a pointer so we don't copy all the names when we are cloned
-	LitValues	mValues;
-	int			mStartOfThawed;
+enum LitValue { LV_False = 0, LV_True = 1, LV_Unassigned = 2 };
 
-	void initValues() {
-		mValues.clear();
-		if (mpNames == nullptr) return;
-		const int n = (int)mpNames->size();
-		for (int i = 0; i < n; i++) {
-			mValues.push_back(false);
-		}
-	}
+enum { CACHE_LINE = 64 };
 
-	void initStartOfThawed() {
-		if (mValues.size() > 0) {
-			mStartOfThawed = 0;
-		}
-		else {
-			mStartOfThawed = -1;
-		}
-	}
+static const uint64_t BYTES_UNASSIGNED = 0x0202020202020202ULL;	// LV_Unassigned in every byte
 
-public:
-	WorkingValues() {
-		mpNames = nullptr;
-		mValues.clear();
-		initStartOfThawed();
-	}
+inline size_t roundUpToCacheLine(const size_t bytes) {
+	return (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
 
-	WorkingValues(const LitNames *pNames) {
-		mpNames = pNames;
-		initValues();
-		initStartOfThawed();
+static void *allocAligned(const size_t bytes) {
+	if (bytes == 0) return nullptr;
+	void *p = aligned_alloc(CACHE_LINE, bytes);
+	if (p == nullptr) {
+		std::cerr << "Out of memory" << std::endl;
+		exit(EXIT_CANNOT_READ_INPUT);
 	}
+	return p;
+}
 
-	WorkingValues(const WorkingValues &other) {
-		mpNames = other.mpNames;
-		mValues = other.mValues;
-		mStartOfThawed = other.mStartOfThawed;
+// Both take cache line aligned buffers whose size is a multiple of CACHE_LINE
+static void fillAligned(void *pDest, const uint64_t pattern, const size_t bytes) {
+#ifdef __SSE2__
+	const __m128i value = _mm_set1_epi64x((long long)pattern);
+	for (char *p = (char *)pDest, *pEnd = p + bytes; p < pEnd; p += 16) {
+		_mm_store_si128((__m128i *)p, value);
 	}
-
-	void clear() {
-		mpNames = nullptr;
-		initValues();
-		initStartOfThawed();
+#else
+	for (uint64_t *p = (uint64_t *)pDest, *pEnd = p + bytes / sizeof(uint64_t); p < pEnd; p++) {
+		*p = pattern;
 	}
+#endif
+}
 
-	void advance(const WorkingValues &in) {
-		mpNames = in.mpNames;
-		mValues = in.mValues;
-		mStartOfThawed = in.mStartOfThawed + 1;
+static void copyAligned(void *pDest, const void *pSrc, const size_t bytes) {
+#ifdef __SSE2__
+	const char *pFrom = (const char *)pSrc;
+	for (char *p = (char *)pDest, *pEnd = p + bytes; p < pEnd; p += 16, pFrom += 16) {
+		_mm_store_si128((__m128i *)p, _mm_load_si128((const __m128i *)pFrom));
 	}
+#else
+	memcpy(pDest, pSrc, bytes);
+#endif
+}
 
-	size_t sizeThawed() const {
-		if (mValues.empty() || mStartOfThawed < 0) return 0;
-		return mValues.size() - mStartOfThawed;
+class LitValues {
+	uint8_t *mpBytes;
+	size_t mSize;
+	size_t mCapacity;	// Bytes allocated
+
+	size_t bytesSize() const { return roundUpToCacheLine(mSize); }
+
+	void alloc(const size_t n) {
+		mSize = n;
+		mCapacity = bytesSize();
+		mpBytes = (uint8_t *)allocAligned(mCapacity);
 	}
 
-	void setFrozenLastBool(const bool b) {
-		mValues[mStartOfThawed - 1] = b;
+	void release() {
+		free(mpBytes);
+		mpBytes = nullptr;
+		mSize = 0;
+		mCapacity = 0;
 	}
 
-	bool getBool(const int i) const {
-		return mValues[i];
+public:
+	LitValues() {
+		mpBytes = nullptr;
+		mSize = 0;
+		mCapacity = 0;
 	}
 
-	std::string toString() const {
-		std::string out;
+	// Starts with everything unassigned
+	LitValues(const size_t n) {
+		alloc(n);
+		clear();
+	}
 
-		if (mpNames == nullptr) {
-			return "mpNames is null";
-		}
+	LitValues(const LitValues &other) {
+		alloc(other.mSize);
+		copyAligned(mpBytes, other.mpBytes, bytesSize());
+	}
 
-		const int n = (int)mpNames->size();
-		for (int i = 0; i < n; i++) {
-			if (!out.empty()) out += " ";
-			out += mpNames->at(i) + "=" + boolToString(mValues[i]);
+	LitValues &operator=(const LitValues &other) {
+		if (this == &other) return *this;
+		if (mSize != other.mSize) {
+			release();
+			alloc(other.mSize);
 		}
-		return out;
+		copyAligned(mpBytes, other.mpBytes, bytesSize());
+		return *this;
 	}
 
-	bool operator==(const WorkingValues &other) const {
-		return mValues == other.mValues;
+	~LitValues() {
+		release();
 	}
-};
-
-//-----------------------------------------------------------------------------
-// Eval
-//    <expr> = <clause> <op> <clause> <op> ...
-//           = <clause>
-//  <clause> = ~ <clause>
-//           = <literal>
-//           = ( <expr> )
-//      <op> = &
-//           = |
-// <literal> = <letter> <alnum> ...
 
-class EvalResult {
-	bool mBoolResult;
-	std::string mError;
+	size_t size() const { return mSize; }
+	bool empty() const { return mSize == 0; }
 
-public:
-	EvalResult() {
-		mError = "No result set";
+	void clear() {
+		fillAligned(mpBytes, BYTES_UNASSIGNED, bytesSize());
 	}
 
-	void setError(const char *format, ...) {
-		char	buf[MAX_ERROR];
-		va_list         ap;
-		va_start(ap, format);
-		vsprintf(buf, format, ap);
-		va_end(ap);
-		mError = buf;
+	// Adds unassigned literals up to n.  The room doubles when it runs out,
+	// so growing one literal at a time stays linear.
+	void grow(const size_t n) {
+		if (n <= mSize) return;
+		if (roundUpToCacheLine(n) > mCapacity) {
+			const size_t capacity = roundUpToCacheLine(std::max(n, mCapacity * 2));
+			uint8_t *pBytes = (uint8_t *)allocAligned(capacity);
+			if (mSize > 0) copyAligned(pBytes, mpBytes, bytesSize());
+			free(mpBytes);
+			mpBytes = pBytes;
+			mCapacity = capacity;
+		}
+		memset(mpBytes + mSize, LV_Unassigned, n - mSize);
+		mSize = n;
 	}
 
-	bool isError() const { return ! mError.empty(); }
+	LitValue get(const size_t i) const { return (LitValue)mpBytes[i]; }
 
-	std::string getError() const { return mError; }
+	// Unassigned reads as false
+	bool isTrue(const size_t i) const { return mpBytes[i] == LV_True; }
 
-	void setBool(const bool b) {
-		mError.clear();
-		mBoolResult = b;
+	void set(const size_t i, const LitValue value) {
+		mpBytes[i] = (uint8_t)value;
 	}
 
-	bool getBool() const { return mBoolResult; }
-	bool isSatisfied() const { return getBool(); }
-
-	std::string toString() const {
-		if (isError()) {
-			return mError;
-		}
-
-		return boolToString(mBoolResult);
+	void set(const size_t i, const bool b) {
+		set(i, b ? LV_True : LV_False);
 	}
+
+	// One byte per literal, LV_True/LV_False/LV_Unassigned
+	const uint8_t *bytes() const { return mpBytes; }
 };
 
 //-----------------------------------------------------------------------------
-// Eval
-
-static EvalResult eval(const Tokens &, Tokens::const_iterator &, const WorkingValues &, const int depth);
-
-static EvalResult evalClause(const Tokens &tokens, Tokens::const_iterator &it, const WorkingValues &literals, const int depth) {
-	EvalResult result;
-
-	switch(it->getType()) {
-	case TT_Unknown:
-		result.setError("Encountered Unknown token");
-		return result;
-	case TT_And:
-		result.setError("A clause cannot begin with an &");
-		return result;
-	case TT_Or:
-		result.setError("A clause cannot begin with an |");
-		return result;
-	case TT_Not:
-		 {
-			it++;
-			if (it == tokens.end()) {
-				result.setError("Expected something after a Not");
-				return result;
-			}
+// Words (bit-vectors)
+// A word "x:8" is declared by giving its width at least once inside { }.
+// Its bits become ordinary literals named x.0 (least significant) to x.7,
+// appended after the boolean literals so they never clash with them.
 
-			const EvalResult right = evalClause(tokens, it, literals, depth + 1);
-			if (right.isError()) {
-				return right;
-			}
+enum { MIN_WORD_WIDTH = 1, MAX_WORD_WIDTH = 64 };
 
-			result.setBool(! right.getBool());
-			return result;
-		 }
-	case TT_Literal:
-		{
-			const int idx = it->getLitIndex();
-			if (idx < 0) {
-				result.setError("Unknown Literal %s", it->getLiteral().c_str());
-				return result;
-			}
-			result.setBool(literals.getBool(idx));
-			return result;
-		}
-	case TT_OpenBracket:
-		{
-			it++;
-			if (it == tokens.end()) {
-				result.setError("Expected something after an Open Bracket");
-				return result;
-			}
+class WordDecl {
+public:
+	std::string mName;
+	int mWidth;
+	int mFirstLit;
 
-			const EvalResult right = eval(tokens, it, literals, depth + 1);
+	WordDecl(const std::string &name, const int width) {
+		mName = name;
+		mWidth = width;
+		mFirstLit = -1;
+	}
+};
 
-			it++;
-			if (!it->isCloseBracket()) {
-				result.setError("Expected Close Bracket");
-				return result;
-			}
+typedef std::vector<WordDecl> WordDecls;
 
-			return right;
-		 }
-	case TT_CloseBracket:
-		result.setError("Unexpected Close Bracket");
-		return result;
-	case TT_Space:
-		result.setError("Unexpected Space");
-		return result;
-	case TT_Eof:
-		result.setError("Unexpected Eof");
-		return result;
+inline int findWordDecl(const WordDecls &words, const std::string &target) {
+	const int n = (int)words.size();
+	for (int i = 0; i < n; i++) {
+		if (words[i].mName == target) return i;
 	}
-
-	result.setError("Interal error in evalClause");
-	return result;
+	return -1;
 }
 
-static EvalResult eval(const Tokens &tokens, Tokens::const_iterator &it, const WorkingValues &literals, const int depth) {
-	if (depth > gnMaxDepth) {
-		gnMaxDepth = depth;
-	}
+static bool parseNumber(const std::string &text, uint64_t &value) {
+	const bool hex = text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+	char *end = nullptr;
+	errno = 0;
+	value = strtoull(text.c_str(), &end, hex ? 16 : 10);
+	return errno == 0 && end != nullptr && *end == '\0';
+}
 
-	EvalResult result = evalClause(tokens, it, literals, depth + 1);
-	it++;
-	if (it == tokens.end()) {
-		return result;
-	}
+// Returns an empty string or an error
+static std::string getWordDecls(const Tokens &tokens, WordDecls &words, LitNames &litnames) {
+	int braces = 0;
+	for (auto it = tokens.begin(); it != tokens.end(); it++) {
+		if (it->getType() == TT_OpenBrace) braces++;
+		if (it->getType() == TT_CloseBrace && braces > 0) braces--;
+		if (!it->isLiteral() || braces == 0) continue;
 
-	for (; it != tokens.end(); it++) {
-		const TokType type2 = it->getType();
-		if (type2 == TT_CloseBracket) {
-			it--;	// Unget
-			return result;
+		auto colon = it + 1;
+		if (colon == tokens.end() || colon->getType() != TT_Colon) continue;
+		auto number = colon + 1;
+		uint64_t width;
+		if (number == tokens.end() || !number->isNumber() || !parseNumber(number->getLiteral(), width)) {
+			return "Expected a width after " + it->getLiteral() + ":";
 		}
-
-		if (type2 != TT_And && type2 != TT_Or) {
-			result.setError("Unexpected %s -- Only And/Or can connect clauses", it->toString().c_str());
-			return result;
+		if (width < MIN_WORD_WIDTH || width > MAX_WORD_WIDTH) {
+			return "Word " + it->getLiteral() + " must be 1 to 64 bits wide";
 		}
 
-		it++;
-		if (it == tokens.end()) {
-			result.setError("Expected something after an And/Or");
-			return result;
+		const int idx = findWordDecl(words, it->getLiteral());
+		if (idx < 0) {
+			words.push_back(WordDecl(it->getLiteral(), (int)width));
 		}
-
-		const EvalResult right = evalClause(tokens, it, literals, depth + 1);
-		if (right.isError()) {
-			return right;
+		else if (words[idx].mWidth != (int)width) {
+			return "Word " + it->getLiteral() + " is declared with two different widths";
 		}
+	}
 
-		if (type2 == TT_And) {
-			result.setBool(result.getBool() && right.getBool());
-		}
-		else if (type2 == TT_Or) {
-			result.setBool(result.getBool() || right.getBool());
+	for (auto it = words.begin(); it != words.end(); it++) {
+		it->mFirstLit = (int)litnames.size();
+		for (int bit = 0; bit < it->mWidth; bit++) {
+			litnames.push_back(it->mName + "." + std::to_string(bit));
 		}
 	}
 
-	return result;
+	return "";
 }
 
-static EvalResult evalMain(const Tokens &tokens, const WorkingValues &literals, const int depth) {
-	gnEvals++;
+//-----------------------------------------------------------------------------
+// Expression DAG
+// Every formula is compiled into a graph of two-input AND/XOR gates over the
+// literals.  A reference to a node carries a complement bit, so ~ is free, and
+// nodes are structurally hashed so identical sub-expressions (eg the same
+// adder in two constraints) are built exactly once.  Children are always
+// created before their parents, so node order is a topological order.
+
+typedef uint32_t ExprRef;	// node index << 1 | complemented
 
-	if ((gnEvals % MEGA) == 0) {
-		std::cerr << "Evals: " << prettyNumber(gnEvals) << std::endl;
-	}
+enum ExprOp { EO_Const, EO_Var, EO_And, EO_Xor };
 
-	auto it = tokens.begin();
-	return eval(tokens, it, literals, depth + 1);
-}
+static const ExprRef EXPR_FALSE = 0;
+static const ExprRef EXPR_TRUE = 1;
 
-//-----------------------------------------------------------------------------
-// Solve
+inline ExprRef exprNot(const ExprRef r) { return r ^ 1; }
+inline uint32_t exprNode(const ExprRef r) { return r >> 1; }
+inline bool exprIsNegated(const ExprRef r) { return (r & 1) != 0; }
+inline bool exprIsConst(const ExprRef r) { return exprNode(r) == 0; }
 
-class SolveResult {
+class ExprNode {
 public:
-	bool mSatisfied;
-	std::string mError;
-	WorkingValues mLiterals;
+	uint32_t mOp;
+	uint32_t mA;	// EO_Var: literal index, otherwise the first child
+	uint32_t mB;
 
-	SolveResult() {
-		mSatisfied = false;
-		mError = "Not run yet";
+	bool operator==(const ExprNode &other) const {
+		return mOp == other.mOp && mA == other.mA && mB == other.mB;
 	}
+};
 
-	void setError(const std::string &error) {
-		mError = error;
+class ExprNodeHash {
+public:
+	size_t operator()(const ExprNode &node) const {
+		uint64_t h = ((uint64_t)node.mA << 32) | node.mB;
+		h ^= (uint64_t)node.mOp * 0x9e3779b97f4a7c15ULL;
+		h ^= h >> 29;
+		h *= 0xbf58476d1ce4e5b9ULL;
+		return (size_t)(h ^ (h >> 32));
 	}
+};
 
-	bool isError() const { return ! mError.empty(); }
+typedef std::vector<ExprNode> ExprNodes;
 
-	void setSatisfied(const WorkingValues &literals) {
-		mSatisfied = true;
-		mError.clear();
-		mLiterals = literals;
+// Read-only nodes, either an ExprGraph's or straight out of a compiled file
+class ExprView {
+public:
+	const ExprNode *mpNodes;
+	size_t mnNodes;
+
+	ExprView() {
+		mpNodes = nullptr;
+		mnNodes = 0;
 	}
 
-	void setUnsat() {
-		mSatisfied = false;
-		mError.clear();
-		mLiterals.clear();
+	ExprView(const ExprNode *pNodes, const size_t nNodes) {
+		mpNodes = pNodes;
+		mnNodes = nNodes;
 	}
 
-	bool isSatisfied() const { return mSatisfied; }
+	const ExprNode &operator[](const size_t i) const { return mpNodes[i]; }
+	size_t size() const { return mnNodes; }
+};
 
-	std::string toString() const {
-		if (isError()) {
-			return mError;
-		}
+class ExprGraph {
+	ExprNodes mNodes;
+	std::unordered_map<ExprNode, uint32_t, ExprNodeHash> mHash;
+	std::vector<ExprRef> mVars;	// Literal index to its EO_Var node
 
-		if (!isSatisfied()) {
-			return "Unstatisfied";
+	ExprRef mkNode(const ExprOp op, const uint32_t a, const uint32_t b) {
+		ExprNode node;
+		node.mOp = op;
+		node.mA = a;
+		node.mB = b;
+
+		auto found = mHash.find(node);
+		if (found != mHash.end()) return found->second << 1;
+
+		const uint32_t idx = (uint32_t)mNodes.size();
+		mNodes.push_back(node);
+		mHash[node] = idx;
+		return idx << 1;
+	}
+
+public:
+	ExprGraph() {
+		ExprNode node;
+		node.mOp = EO_Const;
+		node.mA = 0;
+		node.mB = 0;
+		mNodes.push_back(node);
+	}
+
+	// Takes a copy of nodes that are already hashed, eg from a compiled file
+	ExprGraph(const ExprView &view) {
+		mNodes.assign(view.mpNodes, view.mpNodes + view.size());
+		mHash.reserve(mNodes.size());
+		for (uint32_t i = 1; i < (uint32_t)mNodes.size(); i++) {
+			mHash[mNodes[i]] = i;
+			if (mNodes[i].mOp == EO_Var) {
+				if (mVars.size() <= mNodes[i].mA) mVars.resize(mNodes[i].mA + 1, EXPR_FALSE);
+				mVars[mNodes[i].mA] = i << 1;
+			}
 		}
+	}
 
-		return "Satisfied with " + mLiterals.toString();
+	ExprView view() const { return ExprView(mNodes.data(), mNodes.size()); }
+	size_t size() const { return mNodes.size(); }
+
+	ExprRef mkVar(const int litIndex) {
+		if ((int)mVars.size() <= litIndex) {
+			mVars.resize(litIndex + 1, EXPR_FALSE);
+		}
+		if (mVars[litIndex] == EXPR_FALSE) {
+			mVars[litIndex] = mkNode(EO_Var, litIndex, 0);
+		}
+		return mVars[litIndex];
 	}
-};
 
-static SolveResult solve(const Tokens &tokens, const WorkingValues &literals, const int depth) {
-	SolveResult solveResult;
+	ExprRef mkAnd(ExprRef a, ExprRef b) {
+		if (a > b) std::swap(a, b);
+		if (a == EXPR_FALSE) return EXPR_FALSE;
+		if (a == EXPR_TRUE) return b;
+		if (a == b) return a;
+		if (a == exprNot(b)) return EXPR_FALSE;
+		return mkNode(EO_And, a, b);
+	}
 
-	const EvalResult evalResult = evalMain(tokens, literals, depth + 1);
-	if (evalResult.isError()) {
-		solveResult.setError(evalResult.getError());
-		return solveResult;
+	ExprRef mkOr(const ExprRef a, const ExprRef b) {
+		return exprNot(mkAnd(exprNot(a), exprNot(b)));
 	}
 
-	if (evalResult.isSatisfied()) {
-		solveResult.setSatisfied(literals);
-		return solveResult;
+	// XOR nodes only ever have uncomplemented children -- the complements are
+	// pulled out onto the result so ~a ^ b and a ^ ~b share a node
+	ExprRef mkXor(ExprRef a, ExprRef b) {
+		const ExprRef flip = (a ^ b) & 1;
+		a &= ~1u;
+		b &= ~1u;
+		if (a > b) std::swap(a, b);
+		if (a == EXPR_FALSE) return b ^ flip;
+		if (a == b) return EXPR_FALSE ^ flip;
+		return mkNode(EO_Xor, a, b) ^ flip;
 	}
 
-	if (literals.sizeThawed() == 0) {
-		return solveResult;
+	ExprRef mkMux(const ExprRef sel, const ExprRef ifTrue, const ExprRef ifFalse) {
+		return mkOr(mkAnd(sel, ifTrue), mkAnd(exprNot(sel), ifFalse));
 	}
 
-	WorkingValues litNew;
-   	litNew.advance(literals);
+	// Rebuilds root with literal i replaced by replace[i] -- a constant, or
+	// mkVar(i) to keep it.  Literals past the end of replace are kept.
+	// Nodes are topologically ordered, so this is one forward pass.
+	ExprRef substitute(const ExprRef root, const std::vector<ExprRef> &replace) {
+		const uint32_t last = exprNode(root);
+		std::vector<ExprRef> map(last + 1, EXPR_FALSE);
 
-	for (int i = 0; i < gnBools; i++) {
-		litNew.setFrozenLastBool(gBools[i]);
-		const SolveResult solveResult = solve(tokens, litNew, depth + 1);
-		if (solveResult.isSatisfied()) {
-			return solveResult;
+		for (uint32_t i = 1; i <= last; i++) {
+			const ExprNode node = mNodes[i];	// Copy -- mNodes may grow below
+			switch (node.mOp) {
+			case EO_Var:
+				map[i] = node.mA < replace.size() ? replace[node.mA] : (i << 1);
+				break;
+			case EO_And:
+				map[i] = mkAnd(map[exprNode(node.mA)] ^ (node.mA & 1), map[exprNode(node.mB)] ^ (node.mB & 1));
+				break;
+			case EO_Xor:
+				map[i] = mkXor(map[exprNode(node.mA)], map[exprNode(node.mB)]);
+				break;
+			}
 		}
+
+		return map[last] ^ (root & 1);
 	}
+};
 
-	solveResult.setUnsat();
-	return solveResult;
+// Marks the nodes root depends on.  Parents always come after their
+// children, so one backward pass finds them all.
+static void markCone(const ExprView &nodes, const ExprRef root, std::vector<char> &reachable) {
+	const uint32_t last = exprNode(root);
+	reachable.assign(last + 1, false);
+	reachable[last] = true;
+	for (uint32_t i = last; i > 0; i--) {
+		if (!reachable[i] || nodes[i].mOp == EO_Var) continue;
+		reachable[exprNode(nodes[i].mA)] = true;
+		reachable[exprNode(nodes[i].mB)] = true;
+	}
 }
 
-static void solveMain(Tokens &tokens) {
-	const int depth = 0;
-	LitNames litnames;
-	getLitNames(tokens, litnames);
-	assignLiteralIndexes(tokens, litnames);
+//-----------------------------------------------------------------------------
+// Bit-Blasting
+// Word-level operations are lowered to gates in the expression DAG, least
+// significant bit first.  Results are also memoized at the word level, so a
+// repeated "x + y" or "x < y" costs one map lookup rather than a re-blast,
+// and the gates themselves are shared through the DAG's structural hashing.
 
-	if (litnames.size() == 0) {
-		std::cerr << "There are no literals -- nothing to solve" << std::endl;
-		exit(EXIT_CANNOT_PARSE_INPUT);
-	}
+typedef std::vector<ExprRef> Word;
 
-	printLitNames(litnames);
+enum WordOp { WO_Add, WO_Sub, WO_And, WO_Or, WO_Xor, WO_Shl, WO_Shr, WO_Eq, WO_Ult };
 
-	//
-	// Eval once to check syntax
-	//
+class BitBlaster {
+	ExprGraph &mGraph;
+	std::map<std::vector<ExprRef>, Word> mMemo;
 
-	WorkingValues literals(&litnames);
-	const EvalResult chkResult = evalMain(tokens, literals, depth + 1);
-	if (chkResult.isError()) {
-		std::cerr << "Formula has invalid syntax -- " << chkResult.toString() << std::endl;
-		exit(EXIT_CANNOT_PARSE_INPUT);
-		return;
+	static bool isCommutative(const WordOp op) {
+		return op == WO_Add || op == WO_And || op == WO_Or || op == WO_Xor || op == WO_Eq;
 	}
 
-	//
-	// Now solve
-	//
+	std::vector<ExprRef> memoKey(const WordOp op, const Word &a, const Word &b) const {
+		const bool swap = isCommutative(op) && b < a;
+		const Word &first = swap ? b : a;
+		const Word &second = swap ? a : b;
 
-	const SolveResult solveResult = solve(tokens, literals, depth + 1);
-	std::cout << solveResult.toString() << std::endl;
-	std::cout << "  Number of Evals: " << prettyNumber(gnEvals) << std::endl;
-	std::cout << "        Max Depth: " << prettyNumber(gnMaxDepth) << std::endl;
-	
-	if (solveResult.isError()) {
-		exit(EXIT_CANNOT_PARSE_INPUT);
+		std::vector<ExprRef> key;
+		key.reserve(first.size() + second.size() + 2);
+		key.push_back(op);
+		key.push_back((ExprRef)first.size());
+		key.insert(key.end(), first.begin(), first.end());
+		key.insert(key.end(), second.begin(), second.end());
+		return key;
 	}
-	else {
-		if (solveResult.isSatisfied()) {
-			exit(EXIT_SATISFIABLE);
+
+	Word add(const Word &a, const Word &b, ExprRef carry) {
+		Word out(a.size());
+		for (size_t i = 0; i < a.size(); i++) {
+			const ExprRef half = mGraph.mkXor(a[i], b[i]);
+			out[i] = mGraph.mkXor(half, carry);
+			carry = mGraph.mkOr(mGraph.mkAnd(a[i], b[i]), mGraph.mkAnd(carry, half));
 		}
-		else {
-			exit(EXIT_UNSATISFIABLE);
+		return out;
+	}
+
+	Word bitwise(const WordOp op, const Word &a, const Word &b) {
+		Word out(a.size());
+		for (size_t i = 0; i < a.size(); i++) {
+			if (op == WO_And) out[i] = mGraph.mkAnd(a[i], b[i]);
+			else if (op == WO_Or) out[i] = mGraph.mkOr(a[i], b[i]);
+			else out[i] = mGraph.mkXor(a[i], b[i]);
 		}
+		return out;
 	}
-}
 
-//-----------------------------------------------------------------------------
-// Main
+	// Barrel shifter: stage k shifts by 2^k when bit k of the amount is set
+	Word shift(const WordOp op, const Word &a, const Word &amount) {
+		const size_t width = a.size();
+		Word cur = a;
+		for (size_t k = 0; k < amount.size(); k++) {
+			Word next(width);
+			const uint64_t dist = k < 63 ? (uint64_t)1 << k : width;
+			for (size_t i = 0; i < width; i++) {
+				ExprRef moved = EXPR_FALSE;
+				if (dist < width) {
+					if (op == WO_Shl && i >= dist) moved = cur[i - dist];
+					if (op == WO_Shr && i + dist < width) moved = cur[i + dist];
+				}
+				next[i] = mGraph.mkMux(amount[k], moved, cur[i]);
+			}
+			cur = next;
+		}
+		return cur;
+	}
+
+	ExprRef equal(const Word &a, const Word &b) {
+		ExprRef out = EXPR_TRUE;
+		for (size_t i = 0; i < a.size(); i++) {
+			out = mGraph.mkAnd(out, exprNot(mGraph.mkXor(a[i], b[i])));
+		}
+		return out;
+	}
+
+	// Unsigned a < b, decided by the most significant differing bit
+	ExprRef lessThan(const Word &a, const Word &b) {
+		ExprRef out = EXPR_FALSE;
+		for (size_t i = 0; i < a.size(); i++) {
+			const ExprRef differ = mGraph.mkXor(a[i], b[i]);
+			out = mGraph.mkMux(differ, b[i], out);
+		}
+		return out;
+	}
+
+public:
+	BitBlaster(ExprGraph &graph) : mGraph(graph) {
+	}
+
+	Word constant(const uint64_t value, const int width) const {
+		Word out(width);
+		for (int i = 0; i < width; i++) {
+			out[i] = ((value >> i) & 1) ? EXPR_TRUE : EXPR_FALSE;
+		}
+		return out;
+	}
+
+	Word variable(const WordDecl &decl) {
+		Word out(decl.mWidth);
+		for (int i = 0; i < decl.mWidth; i++) {
+			out[i] = mGraph.mkVar(decl.mFirstLit + i);
+		}
+		return out;
+	}
+
+	Word bitNot(const Word &a) const {
+		Word out(a.size());
+		for (size_t i = 0; i < a.size(); i++) {
+			out[i] = exprNot(a[i]);
+		}
+		return out;
+	}
+
+	// Both words must have the same width, except the shift amount
+	Word apply(const WordOp op, const Word &a, const Word &b) {
+		const std::vector<ExprRef> key = memoKey(op, a, b);
+		auto found = mMemo.find(key);
+		if (found != mMemo.end()) return found->second;
+
+		Word out;
+		switch (op) {
+		case WO_Add: out = add(a, b, EXPR_FALSE); break;
+		case WO_Sub: out = add(a, bitNot(b), EXPR_TRUE); break;
+		case WO_And:
+		case WO_Or:
+		case WO_Xor: out = bitwise(op, a, b); break;
+		case WO_Shl:
+		case WO_Shr: out = shift(op, a, b); break;
+		case WO_Eq: out.push_back(equal(a, b)); break;
+		case WO_Ult: out.push_back(lessThan(a, b)); break;
+		}
+
+		mMemo[key] = out;
+		return out;
+	}
+
+	ExprRef compare(const TokType cmp, const Word &a, const Word &b) {
+		switch (cmp) {
+		case TT_Eq: return apply(WO_Eq, a, b)[0];
+		case TT_Ne: return exprNot(apply(WO_Eq, a, b)[0]);
+		case TT_Lt: return apply(WO_Ult, a, b)[0];
+		case TT_Gt: return apply(WO_Ult, b, a)[0];
+		case TT_Le: return exprNot(apply(WO_Ult, b, a)[0]);
+		case TT_Ge: return exprNot(apply(WO_Ult, a, b)[0]);
+		default: return EXPR_FALSE;	// Should never happen
+		}
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Compile
+//    <expr> = <clause> <op> <clause> <op> ...
+//           = <clause>
+//  <clause> = ~ <clause>
+//           = <literal>
+//           = ( <expr> )
+//           = { <term> <cmp> <term> }
+//      <op> = &
+//           = |
+// <literal> = <letter> <alnum> ...
+//
+// Inside { } everything is a word and the operators are bitwise/arithmetic,
+// from loosest to tightest binding:  |  ^  &  << >>  + -  then unary ~
+//    <term> = <word> | <word> : <width> | <number> | ( <term> ) | ~ <term>
+//     <cmp> = == | != | < | <= | > | >=   (unsigned)
+
+class ParseResult {
+	ExprRef mRef;
+	std::string mError;
+
+public:
+	ParseResult() {
+		mRef = EXPR_FALSE;
+		mError = "No result set";
+	}
+
+	void setError(const char *format, ...) {
+		char	buf[MAX_ERROR];
+		va_list         ap;
+		va_start(ap, format);
+		vsnprintf(buf, sizeof(buf), format, ap);
+		va_end(ap);
+		mError = buf;
+	}
+
+	bool isError() const { return ! mError.empty(); }
+
+	std::string getError() const { return mError; }
+
+	void setRef(const ExprRef ref) {
+		mError.clear();
+		mRef = ref;
+	}
+
+	ExprRef getRef() const { return mRef; }
+};
+
+// A word-level value.  Numbers stay unsized until they meet a sized operand.
+class WordTerm {
+public:
+	Word mBits;
+	bool mSized;
+	uint64_t mConst;
+
+	WordTerm() {
+		mSized = false;
+		mConst = 0;
+	}
+
+	int width() const { return (int)mBits.size(); }
+};
+
+// Work waiting on the explicit stack: an operator still missing its right
+// operand, or an open bracket/brace.  The stack lives on the heap, so nesting
+// depth is limited by memory rather than by the C++ call stack.
+class PendingOp {
+public:
+	TokType mType;
+	ExprRef mLeft;	// The left operand of a boolean & or |
+
+	PendingOp(const TokType type, const ExprRef left) {
+		mType = type;
+		mLeft = left;
+	}
+};
+
+// A single left to right pass over the tokens (shunting-yard).  Boolean
+// operators all bind equally tightly, so they are applied as soon as their
+// right operand is complete.  Word operators wait on the stack until an
+// operator that binds no tighter arrives.
+class Compiler {
+	const Tokens &mTokens;
+	Tokens::const_iterator mIt;
+	const WordDecls &mWords;
+	ExprGraph &mGraph;
+	BitBlaster mBlaster;
+
+	std::vector<PendingOp> mStack;
+	std::vector<WordTerm> mWordOperands;
+	ExprRef mCurrent;	// The last complete boolean operand
+	bool mExpectOperand;
+	bool mInBraces;
+
+	bool atEnd() const { return mIt == mTokens.end(); }
+	TokType top() const { return mStack.empty() ? TT_Eof : mStack.back().mType; }
+
+	static bool isComparison(const TokType type) {
+		return type == TT_Eq || type == TT_Ne || type == TT_Lt || type == TT_Le || type == TT_Gt || type == TT_Ge;
+	}
+
+	// Word operators, loosest binding first.  0 means not a word operator.
+	static int precedence(const TokType type) {
+		switch (type) {
+		case TT_Or: return 1;
+		case TT_Xor: return 2;
+		case TT_And: return 3;
+		case TT_Shl:
+		case TT_Shr: return 4;
+		case TT_Plus:
+		case TT_Minus: return 5;
+		default: return 0;
+		}
+	}
+
+	static WordOp toWordOp(const TokType type) {
+		switch (type) {
+		case TT_Or: return WO_Or;
+		case TT_Xor: return WO_Xor;
+		case TT_And: return WO_And;
+		case TT_Shl: return WO_Shl;
+		case TT_Shr: return WO_Shr;
+		case TT_Plus: return WO_Add;
+		default: return WO_Sub;
+		}
+	}
+
+	static uint64_t foldConst(const TokType type, const uint64_t a, const uint64_t b) {
+		switch (type) {
+		case TT_Or: return a | b;
+		case TT_Xor: return a ^ b;
+		case TT_And: return a & b;
+		case TT_Shl: return b >= 64 ? 0 : a << b;
+		case TT_Shr: return b >= 64 ? 0 : a >> b;
+		case TT_Plus: return a + b;
+		default: return a - b;
+		}
+	}
+
+	bool sizeTo(WordTerm &term, const int width, ParseResult &result) {
+		if (term.mSized) return true;
+		if (width < 64 && (term.mConst >> width) != 0) {
+			result.setError("Constant %llu does not fit in %d bits", (unsigned long long)term.mConst, width);
+			return false;
+		}
+		term.mBits = mBlaster.constant(term.mConst, width);
+		term.mSized = true;
+		return true;
+	}
+
+	// Gives two operands the same width.  Returns false if it cannot.
+	bool unify(WordTerm &a, WordTerm &b, ParseResult &result) {
+		if (!a.mSized && !b.mSized) return true;
+		if (!sizeTo(a, b.mSized ? b.width() : a.width(), result)) return false;
+		if (!sizeTo(b, a.width(), result)) return false;
+		if (a.width() != b.width()) {
+			result.setError("Width mismatch -- %d bits vs %d bits", a.width(), b.width());
+			return false;
+		}
+		return true;
+	}
+
+	//
+	// Boolean level
+	//
+
+	// Applies any ~ and & | that were waiting for this operand
+	void finishBool(ExprRef ref) {
+		for (;;) {
+			const TokType type = top();
+			if (type == TT_Not) {
+				ref = exprNot(ref);
+			}
+			else if (type == TT_And) {
+				ref = mGraph.mkAnd(mStack.back().mLeft, ref);
+			}
+			else if (type == TT_Or) {
+				ref = mGraph.mkOr(mStack.back().mLeft, ref);
+			}
+			else {
+				break;
+			}
+			mStack.pop_back();
+		}
+
+		mCurrent = ref;
+		mExpectOperand = false;
+	}
+
+	bool boolOperand(ParseResult &result) {
+		const TokType type = mIt->getType();
+		switch (type) {
+		case TT_Not:
+		case TT_OpenBracket:
+			mStack.push_back(PendingOp(type, EXPR_FALSE));
+			break;
+		case TT_OpenBrace:
+			mStack.push_back(PendingOp(type, EXPR_FALSE));
+			mInBraces = true;
+			break;
+		case TT_Literal:
+			{
+				const int idx = mIt->getLitIndex();
+				if (idx < 0) {
+					result.setError("Unknown Literal %s", mIt->getLiteral().c_str());
+					return false;
+				}
+				finishBool(mGraph.mkVar(idx));
+				break;
+			}
+		case TT_And:
+			result.setError("A clause cannot begin with an &");
+			return false;
+		case TT_Or:
+			result.setError("A clause cannot begin with an |");
+			return false;
+		case TT_CloseBracket:
+			result.setError("Unexpected Close Bracket");
+			return false;
+		case TT_Unknown:
+			result.setError("Encountered Unknown token");
+			return false;
+		default:
+			result.setError("Unexpected %s outside of { }", typeToString(type).c_str());
+			return false;
+		}
+
+		mIt++;
+		return true;
+	}
+
+	bool boolOperator(ParseResult &result) {
+		const TokType type = mIt->getType();
+		if (type == TT_And || type == TT_Or) {
+			mStack.push_back(PendingOp(type, mCurrent));
+			mExpectOperand = true;
+		}
+		else if (type == TT_CloseBracket) {
+			if (top() != TT_OpenBracket) {
+				result.setError("Unexpected )");
+				return false;
+			}
+			mStack.pop_back();
+			finishBool(mCurrent);
+		}
+		else {
+			result.setError("Unexpected %s -- Only And/Or can connect clauses", mIt->toString().c_str());
+			return false;
+		}
+
+		mIt++;
+		return true;
+	}
+
+	//
+	// Word level, inside { }
+	//
+
+	// Applies any ~ that were waiting for this operand
+	bool finishWord(WordTerm &term, ParseResult &result) {
+		while (top() == TT_Not) {
+			if (!term.mSized) {
+				result.setError("Cannot tell the width of ~ on a constant");
+				return false;
+			}
+			term.mBits = mBlaster.bitNot(term.mBits);
+			mStack.pop_back();
+		}
+
+		mWordOperands.push_back(term);
+		mExpectOperand = false;
+		return true;
+	}
+
+	bool applyWordOp(const TokType type, WordTerm &term, WordTerm &right, ParseResult &result) {
+		if (!term.mSized && !right.mSized) {
+			term.mConst = foldConst(type, term.mConst, right.mConst);
+			return true;
+		}
+
+		if (type == TT_Shl || type == TT_Shr) {
+			if (!term.mSized) {
+				result.setError("Cannot tell the width of a shifted constant");
+				return false;
+			}
+			if (!right.mSized) {
+				// Amounts of the width or more shift everything out anyway
+				const uint64_t amount = std::min<uint64_t>(right.mConst, term.width());
+				right.mBits = mBlaster.constant(amount, 7);
+				right.mSized = true;
+			}
+		}
+		else if (!unify(term, right, result)) {
+			return false;
+		}
+
+		term.mBits = mBlaster.apply(toWordOp(type), term.mBits, right.mBits);
+		return true;
+	}
+
+	// Applies waiting word operators that bind at least as tightly as minPrecedence
+	bool reduceWords(const int minPrecedence, ParseResult &result) {
+		while (precedence(top()) >= minPrecedence && precedence(top()) > 0) {
+			const TokType type = top();
+			mStack.pop_back();
+
+			WordTerm right = mWordOperands.back();
+			mWordOperands.pop_back();
+			if (!applyWordOp(type, mWordOperands.back(), right, result)) return false;
+		}
+		return true;
+	}
+
+	bool wordOperand(ParseResult &result) {
+		const TokType type = mIt->getType();
+		switch (type) {
+		case TT_Not:
+		case TT_OpenBracket:
+			mStack.push_back(PendingOp(type, EXPR_FALSE));
+			mIt++;
+			return true;
+		case TT_Number:
+			{
+				WordTerm term;
+				if (!parseNumber(mIt->getLiteral(), term.mConst)) {
+					result.setError("Bad number %s", mIt->getLiteral().c_str());
+					return false;
+				}
+				mIt++;
+				return finishWord(term, result);
+			}
+		case TT_Literal:
+			{
+				const int idx = findWordDecl(mWords, mIt->getLiteral());
+				if (idx < 0) {
+					result.setError("Word %s has no width -- declare it as %s:<width>", mIt->getLiteral().c_str(), mIt->getLiteral().c_str());
+					return false;
+				}
+				mIt++;
+				if (!atEnd() && mIt->getType() == TT_Colon) {
+					mIt += 2;	// Width was checked by getWordDecls()
+				}
+
+				WordTerm term;
+				term.mBits = mBlaster.variable(mWords[idx]);
+				term.mSized = true;
+				return finishWord(term, result);
+			}
+		default:
+			result.setError("Unexpected %s in a word expression", typeToString(type).c_str());
+			return false;
+		}
+	}
+
+	bool wordOperator(ParseResult &result) {
+		const TokType type = mIt->getType();
+		mIt++;
+
+		if (precedence(type) > 0) {
+			if (!reduceWords(precedence(type), result)) return false;
+			mStack.push_back(PendingOp(type, EXPR_FALSE));
+			mExpectOperand = true;
+			return true;
+		}
+
+		if (!reduceWords(1, result)) return false;
+
+		if (isComparison(type)) {
+			if (top() != TT_OpenBrace) {
+				result.setError(top() == TT_OpenBracket ? "Expected Close Bracket" : "Expected Close Brace");
+				return false;
+			}
+			mStack.push_back(PendingOp(type, EXPR_FALSE));
+			mExpectOperand = true;
+			return true;
+		}
+
+		if (type == TT_CloseBracket) {
+			if (top() != TT_OpenBracket) {
+				result.setError("Unexpected ) in a word expression");
+				return false;
+			}
+			mStack.pop_back();
+			WordTerm term = mWordOperands.back();
+			mWordOperands.pop_back();
+			return finishWord(term, result);
+		}
+
+		if (type == TT_CloseBrace) {
+			const TokType cmp = top();
+			if (!isComparison(cmp)) {
+				result.setError(cmp == TT_OpenBracket ? "Expected Close Bracket" : "Expected a comparison in { } but found }");
+				return false;
+			}
+			mStack.pop_back();
+			mStack.pop_back();	// The brace
+			mInBraces = false;
+
+			WordTerm right = mWordOperands.back();
+			mWordOperands.pop_back();
+			WordTerm left = mWordOperands.back();
+			mWordOperands.pop_back();
+
+			if (!left.mSized && !right.mSized) {
+				// Nothing to bit-blast -- both sides are numbers
+				left.mSized = right.mSized = true;
+				left.mBits = mBlaster.constant(left.mConst, 64);
+				right.mBits = mBlaster.constant(right.mConst, 64);
+			}
+			if (!unify(left, right, result)) return false;
+
+			finishBool(mBlaster.compare(cmp, left.mBits, right.mBits));
+			return true;
+		}
+
+		if (top() == TT_OpenBrace) {
+			result.setError("Expected a comparison in { } but found %s", typeToString(type).c_str());
+		}
+		else {
+			result.setError("Unexpected %s in a word expression", typeToString(type).c_str());
+		}
+		return false;
+	}
+
+	// What was left hanging when the tokens ran out
+	std::string endError() const {
+		if (mInBraces) return mExpectOperand ? "Unexpected Eof in a word expression" : "Expected Close Brace";
+		if (mExpectOperand) {
+			switch (top()) {
+			case TT_Not: return "Expected something after a Not";
+			case TT_And:
+			case TT_Or: return "Expected something after an And/Or";
+			case TT_OpenBracket: return "Expected something after an Open Bracket";
+			default: return "Unexpected Eof";
+			}
+		}
+		return mStack.empty() ? "" : "Expected Close Bracket";
+	}
+
+public:
+	Compiler(const Tokens &tokens, const WordDecls &words, ExprGraph &graph) :
+		mTokens(tokens), mWords(words), mGraph(graph), mBlaster(graph) {
+		mIt = mTokens.begin();
+		mCurrent = EXPR_FALSE;
+		mExpectOperand = true;
+		mInBraces = false;
+	}
+
+	ParseResult compile() {
+		ParseResult result;
+
+		while (!atEnd()) {
+			bool ok;
+			if (mInBraces) {
+				ok = mExpectOperand ? wordOperand(result) : wordOperator(result);
+			}
+			else {
+				ok = mExpectOperand ? boolOperand(result) : boolOperator(result);
+			}
+			if (!ok) return result;
+		}
+
+		const std::string error = endError();
+		if (!error.empty()) {
+			result.setError("%s", error.c_str());
+			return result;
+		}
+
+		result.setRef(mCurrent);
+		return result;
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Working Literal Values
+
+// The assignment handed back by the search, one value per literal, with the
+// names and words needed to print it
+class WorkingValues {
+	const LitNames	*mpNames; // This is a pointer so we don't copy all the names when we are cloned
+	const WordDecls	*mpWords;
+	LitValues	mValues;
+
+	void initValues() {
+		const int n = mpNames == nullptr ? 0 : (int)mpNames->size();
+		mValues = LitValues(n);
+	}
+
+public:
+	WorkingValues() {
+		mpNames = nullptr;
+		mpWords = nullptr;
+	}
+
+	WorkingValues(const LitNames *pNames, const WordDecls *pWords) {
+		mpNames = pNames;
+		mpWords = pWords;
+		initValues();
+	}
+
+	WorkingValues(const WorkingValues &other) = default;
+	WorkingValues &operator=(const WorkingValues &other) = default;
+
+	void clear() {
+		mpNames = nullptr;
+		mpWords = nullptr;
+		initValues();
+	}
+
+	bool getBool(const int i) const {
+		return mValues.isTrue(i);
+	}
+
+	void setBool(const int i, const bool b) {
+		mValues.set(i, b);
+	}
+
+	const uint8_t *bytes() const { return mValues.bytes(); }
+
+	size_t size() const { return mValues.size(); }
+
+	std::string toString() const {
+		std::string out;
+
+		if (mpNames == nullptr) {
+			return "mpNames is null";
+		}
+
+		// Word bits come last and are shown as whole words
+		const bool hasWords = mpWords != nullptr && !mpWords->empty();
+		const int n = hasWords ? mpWords->front().mFirstLit : (int)mpNames->size();
+		for (int i = 0; i < n; i++) {
+			if (!out.empty()) out += " ";
+			out += mpNames->at(i) + "=" + boolToString(mValues.isTrue(i));
+		}
+
+		if (hasWords) {
+			for (auto it = mpWords->begin(); it != mpWords->end(); it++) {
+				uint64_t value = 0;
+				for (int bit = 0; bit < it->mWidth; bit++) {
+					if (mValues.isTrue(it->mFirstLit + bit)) value |= (uint64_t)1 << bit;
+				}
+				if (!out.empty()) out += " ";
+				out += it->mName + "=" + std::to_string(value);
+			}
+		}
+		return out;
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Eval
+// The formula was already checked when it was compiled, so evaluation cannot
+// fail and carries no error strings.  The cone of the root is flattened once
+// into a list of steps over 64-bit slots, and every pass after that is a
+// straight run of ANDs and XORs into a preallocated buffer -- no branches on
+// the gate type and no allocation.  The search itself works on clauses; this
+// is an independent check of the model it finds.
+
+class EvalStep {
+public:
+	uint32_t mA;	// Slot << 1 | complemented
+	uint32_t mB;
+	uint64_t mAndMask;	// All ones for AND, zero for XOR
+};
+
+class Evaluator {
+	std::vector<uint32_t> mInputs;	// Literal index for slots 1.. (slot 0 is false)
+	std::vector<EvalStep> mSteps;
+	std::vector<uint64_t> mSlots;
+	uint32_t mOutput;	// Slot << 1 | complemented
+
+	uint64_t run() {
+		uint64_t *pSlots = mSlots.data();
+		uint64_t *pOut = pSlots + 1 + mInputs.size();
+		for (auto it = mSteps.begin(); it != mSteps.end(); it++, pOut++) {
+			const uint64_t a = pSlots[it->mA >> 1] ^ (0 - (uint64_t)(it->mA & 1));
+			const uint64_t b = pSlots[it->mB >> 1] ^ (0 - (uint64_t)(it->mB & 1));
+			*pOut = ((a & b) & it->mAndMask) | ((a ^ b) & ~it->mAndMask);
+		}
+		return pSlots[mOutput >> 1] ^ (0 - (uint64_t)(mOutput & 1));
+	}
+
+public:
+	Evaluator(const ExprView &nodes, const ExprRef root) {
+		const uint32_t last = exprNode(root);
+		std::vector<char> reachable;
+		markCone(nodes, root, reachable);
+
+		std::vector<uint32_t> slot(last + 1, 0);
+		for (uint32_t i = 1; i <= last; i++) {
+			if (reachable[i] && nodes[i].mOp == EO_Var) {
+				mInputs.push_back(nodes[i].mA);
+				slot[i] = (uint32_t)mInputs.size();
+			}
+		}
+		for (uint32_t i = 1; i <= last; i++) {
+			if (!reachable[i] || nodes[i].mOp == EO_Var) continue;
+			EvalStep step;
+			step.mA = slot[exprNode(nodes[i].mA)] << 1 | (nodes[i].mA & 1);
+			step.mB = slot[exprNode(nodes[i].mB)] << 1 | (nodes[i].mB & 1);
+			step.mAndMask = nodes[i].mOp == EO_And ? ~(uint64_t)0 : 0;
+			mSteps.push_back(step);
+			slot[i] = (uint32_t)(mInputs.size() + mSteps.size());
+		}
+
+		mOutput = slot[last] << 1 | (root & 1);
+		mSlots.assign(1 + mInputs.size() + mSteps.size(), 0);
+	}
+
+	// Unassigned literals (LV_Unassigned has the low bit clear) read as false
+	bool eval(const WorkingValues &literals) {
+		const uint8_t *pBytes = literals.bytes();
+		for (size_t i = 0; i < mInputs.size(); i++) {
+			mSlots[i + 1] = 0 - (uint64_t)(pBytes[mInputs[i]] & 1);
+		}
+		return (run() & 1) != 0;
+	}
+};
+
+//-----------------------------------------------------------------------------
+// CNF
+// The search works on clauses, so the DAG is Tseitin encoded: literal i of the
+// formula is variable i, and each AND/XOR gate in the cone of the root gets a
+// variable of its own, numbered after the literals.  A clause literal is
+// packed as var << 1 | negated, so negating it flips the low bit and it can
+// index arrays of 2 * nVars entries directly.
+
+typedef uint32_t Lit;
+
+static const Lit NO_LIT = UINT32_MAX;
+
+inline Lit mkLit(const int var, const bool negated) { return (Lit)var << 1 | (negated ? 1 : 0); }
+inline int litVar(const Lit lit) { return (int)(lit >> 1); }
+inline bool litNegated(const Lit lit) { return (lit & 1) != 0; }
+inline Lit litNot(const Lit lit) { return lit ^ 1; }
+
+typedef std::vector<Lit> Clause;
+typedef std::vector<Clause> Clauses;
+
+// Tseitin clauses for g = a & b, or g = a ^ b
+static void addGateClauses(const ExprOp op, const Lit g, const Lit a, const Lit b, Clauses &clauses) {
+	if (op == EO_And) {
+		clauses.push_back({ litNot(g), a });
+		clauses.push_back({ litNot(g), b });
+		clauses.push_back({ g, litNot(a), litNot(b) });
+	}
+	else {
+		clauses.push_back({ litNot(g), a, b });
+		clauses.push_back({ litNot(g), litNot(a), litNot(b) });
+		clauses.push_back({ g, litNot(a), b });
+		clauses.push_back({ g, a, litNot(b) });
+	}
+}
+
+// Returns the number of variables, which is at least nLits
+static int encodeCnf(const ExprView &nodes, const ExprRef root, const int nLits, Clauses &clauses) {
+	clauses.clear();
+	if (root == EXPR_TRUE) return nLits;
+	if (root == EXPR_FALSE) {
+		clauses.push_back(Clause());
+		return nLits;
+	}
+
+	const uint32_t last = exprNode(root);
+	std::vector<char> reachable;
+	markCone(nodes, root, reachable);
+
+	// Folding keeps constants out of gates, but a compiled file may not have
+	// been folded, so node 0 gets a variable fixed false if anything uses it
+	int nVars = nLits;
+	std::vector<int> nodeVar(last + 1, -1);
+	if (reachable[0]) {
+		nodeVar[0] = nVars++;
+		clauses.push_back(Clause(1, mkLit(nodeVar[0], true)));
+	}
+
+	for (uint32_t i = 1; i <= last; i++) {
+		if (!reachable[i]) continue;
+		const ExprNode &node = nodes[i];
+		if (node.mOp == EO_Var) {
+			nodeVar[i] = (int)node.mA;
+			continue;
+		}
+
+		const Lit g = mkLit(nodeVar[i] = nVars++, false);
+		const Lit a = mkLit(nodeVar[exprNode(node.mA)], exprIsNegated(node.mA));
+		const Lit b = mkLit(nodeVar[exprNode(node.mB)], exprIsNegated(node.mB));
+		addGateClauses((ExprOp)node.mOp, g, a, b, clauses);
+	}
+
+	clauses.push_back(Clause(1, mkLit(nodeVar[last], exprIsNegated(root))));
+	return nVars;
+}
+
+//-----------------------------------------------------------------------------
+// Decision Heuristics
+// The search asks a Brancher which variable to decide next, and tells it
+// about conflicts, assignments and backtracking so it can learn which
+// variables matter.  Different families of formula suit different ones, so
+// the choice is made at run time with -d.
+//   vsids: activity bumped on every conflict a variable is in, older bumps fade
+//   vmtf:  variables in a conflict move to the front of a queue
+//   chb:   a reward for each assignment, weighted towards recent conflicts
+
+enum Heuristic { H_Vsids, H_Vmtf, H_Chb };
+
+static Heuristic gHeuristic = H_Vsids;
+
+static bool parseHeuristic(const std::string &name, Heuristic &heuristic) {
+	static const char *NAMES[] = { "vsids", "vmtf", "chb" };
+	const int i = findName(NAMES, sizeof(NAMES) / sizeof(NAMES[0]), name);
+	if (i < 0) return false;
+	heuristic = (Heuristic)i;
+	return true;
+}
+
+class Brancher {
+public:
+	virtual ~Brancher() {
+	}
+
+	// var was met while analyzing the current conflict
+	virtual void bump(const int var) = 0;
+
+	// The learned clause is in and the search has jumped back
+	virtual void conflictDone(const LitValues &values) = 0;
+
+	// trail[first..] were just assigned by a decision and its propagation
+	virtual void assigned(const std::vector<Lit> &/*trail*/, const size_t /*first*/, const bool /*conflict*/) {
+	}
+
+	virtual void unassigned(const int var) = 0;
+
+	// An unassigned variable, or -1 once everything is assigned
+	virtual int pick(const LitValues &values) = 0;
+
+	// What pick() would return, without taking it
+	virtual int peek(const LitValues &values) = 0;
+
+	// Whether a would be picked ahead of b
+	virtual bool before(const int a, const int b) const = 0;
+
+	// A new unassigned variable, numbered after the rest
+	virtual void addVar() = 0;
+};
+
+// Unassigned variables by score, highest first, as an indexed binary heap so
+// an update or a pick is O(log n).  Assigned variables are only dropped when
+// they reach the top.  Ties go to the lower variable, so before the first
+// conflict the order is still first appearance.
+class VarOrder {
+	const std::vector<double> &mScores;
+	std::vector<int> mHeap;
+	std::vector<int> mPositions;	// Where each variable is in mHeap, or -1
+
+	void place(const int var, const int pos) {
+		mHeap[pos] = var;
+		mPositions[var] = pos;
+	}
+
+	void siftUp(int pos) {
+		const int var = mHeap[pos];
+		while (pos > 0) {
+			const int parent = (pos - 1) / 2;
+			if (!before(var, mHeap[parent])) break;
+			place(mHeap[parent], pos);
+			pos = parent;
+		}
+		place(var, pos);
+	}
+
+	void siftDown(int pos) {
+		const int var = mHeap[pos];
+		const int n = (int)mHeap.size();
+		for (;;) {
+			int child = pos * 2 + 1;
+			if (child >= n) break;
+			if (child + 1 < n && before(mHeap[child + 1], mHeap[child])) child++;
+			if (!before(mHeap[child], var)) break;
+			place(mHeap[child], pos);
+			pos = child;
+		}
+		place(var, pos);
+	}
+
+public:
+	VarOrder(const std::vector<double> &scores) : mScores(scores) {
+	}
+
+	bool before(const int a, const int b) const {
+		return mScores[a] > mScores[b] || (mScores[a] == mScores[b] && a < b);
+	}
+
+	void init(const int nVars) {
+		mHeap.clear();
+		mHeap.reserve(nVars);
+		mPositions.assign(nVars, -1);
+		for (int var = 0; var < nVars; var++) {
+			insert(var);
+		}
+	}
+
+	// The new variable's score must already be there
+	void addVar() {
+		mPositions.push_back(-1);
+		insert((int)mPositions.size() - 1);
+	}
+
+	bool contains(const int var) const { return mPositions[var] >= 0; }
+
+	void insert(const int var) {
+		if (contains(var)) return;
+		mHeap.push_back(var);
+		mPositions[var] = (int)mHeap.size() - 1;
+		siftUp(mPositions[var]);
+	}
+
+	// Call after var's score changes.  Scaling every score keeps the order.
+	void changed(const int var) {
+		if (!contains(var)) return;
+		siftUp(mPositions[var]);
+		siftDown(mPositions[var]);
+	}
+
+	int pick(const LitValues &values) {
+		const int top = peek(values);
+		if (top >= 0) removeTop();
+		return top;
+	}
+
+	// Drops assigned variables off the top, which pick() would do anyway
+	int peek(const LitValues &values) {
+		while (!mHeap.empty() && values.get(mHeap[0]) != LV_Unassigned) {
+			removeTop();
+		}
+		return mHeap.empty() ? -1 : mHeap[0];
+	}
+
+	void removeTop() {
+		const int top = mHeap[0];
+		const int var = mHeap.back();
+		mHeap.pop_back();
+		mPositions[top] = -1;
+		if (!mHeap.empty()) {
+			place(var, 0);
+			siftDown(0);
+		}
+	}
+};
+
+static const double VAR_DECAY = 0.95;
+static const double ACTIVITY_LIMIT = 1e100;
+
+// EVSIDS: rather than decaying every activity after a conflict, the bump
+// grows by 1 / VAR_DECAY, and everything is scaled down when it gets big
+class VsidsBrancher : public Brancher {
+	std::vector<double> mActivity;
+	double mInc;
+	VarOrder mOrder;
+
+public:
+	VsidsBrancher(const int nVars) : mOrder(mActivity) {
+		mActivity.assign(nVars, 0);
+		mInc = 1;
+		mOrder.init(nVars);
+	}
+
+	void bump(const int var) {
+		if ((mActivity[var] += mInc) > ACTIVITY_LIMIT) {
+			for (auto it = mActivity.begin(); it != mActivity.end(); it++) {
+				*it /= ACTIVITY_LIMIT;
+			}
+			mInc /= ACTIVITY_LIMIT;
+		}
+		mOrder.changed(var);
+	}
+
+	void conflictDone(const LitValues &/*values*/) {
+		mInc /= VAR_DECAY;
+	}
+
+	void unassigned(const int var) {
+		mOrder.insert(var);
+	}
+
+	int pick(const LitValues &values) {
+		return mOrder.pick(values);
+	}
+
+	int peek(const LitValues &values) {
+		return mOrder.peek(values);
+	}
+
+	bool before(const int a, const int b) const {
+		return mOrder.before(a, b);
+	}
+
+	void addVar() {
+		mActivity.push_back(0);
+		mOrder.addVar();
+	}
+};
+
+// Variable move-to-front.  The queue is a doubly linked list in bump order,
+// newest last, and every variable newer than mSearch is assigned, so a pick
+// walks back from mSearch and a bump or an unassign is O(1).  A conflict's
+// variables are moved in their old order, so ties keep their history.
+class VmtfBrancher : public Brancher {
+	std::vector<int> mPrev;	// Towards the oldest, -1 at the end
+	std::vector<int> mNext;	// Towards the newest, -1 at the end
+	std::vector<uint64_t> mStamps;	// Larger is newer
+	int mOldest;
+	int mNewest;
+	int mSearch;
+	uint64_t mStamp;
+	std::vector<int> mBumped;
+
+	void dequeue(const int var) {
+		if (mPrev[var] >= 0) mNext[mPrev[var]] = mNext[var];
+		else mOldest = mNext[var];
+		if (mNext[var] >= 0) mPrev[mNext[var]] = mPrev[var];
+		else mNewest = mPrev[var];
+	}
+
+	void enqueue(const int var) {
+		mPrev[var] = mNewest;
+		mNext[var] = -1;
+		if (mNewest >= 0) mNext[mNewest] = var;
+		else mOldest = var;
+		mNewest = var;
+		mStamps[var] = ++mStamp;
+	}
+
+public:
+	// First appearance order, with variable 0 picked first
+	VmtfBrancher(const int nVars) {
+		mPrev.assign(nVars, -1);
+		mNext.assign(nVars, -1);
+		mStamps.assign(nVars, 0);
+		mOldest = mNewest = -1;
+		mStamp = 0;
+		for (int var = nVars - 1; var >= 0; var--) {
+			enqueue(var);
+		}
+		mSearch = mNewest;
+	}
+
+	void bump(const int var) {
+		mBumped.push_back(var);
+	}
+
+	void conflictDone(const LitValues &values) {
+		const std::vector<uint64_t> &stamps = mStamps;
+		std::sort(mBumped.begin(), mBumped.end(), [&stamps](const int a, const int b) { return stamps[a] < stamps[b]; });
+		for (auto it = mBumped.begin(); it != mBumped.end(); it++) {
+			if (*it == mNewest) continue;
+			dequeue(*it);
+			enqueue(*it);
+			if (values.get(*it) == LV_Unassigned) mSearch = *it;
+		}
+		mBumped.clear();
+	}
+
+	void unassigned(const int var) {
+		if (mSearch < 0 || mStamps[var] > mStamps[mSearch]) mSearch = var;
+	}
+
+	int pick(const LitValues &values) {
+		while (mSearch >= 0 && values.get(mSearch) != LV_Unassigned) {
+			mSearch = mPrev[mSearch];
+		}
+		return mSearch;
+	}
+
+	int peek(const LitValues &values) {
+		return pick(values);
+	}
+
+	bool before(const int a, const int b) const {
+		return mStamps[a] > mStamps[b];
+	}
+
+	// Newest, so it is picked next
+	void addVar() {
+		const int var = (int)mPrev.size();
+		mPrev.push_back(-1);
+		mNext.push_back(-1);
+		mStamps.push_back(0);
+		enqueue(var);
+		mSearch = var;
+	}
+};
+
+// Conflict history based branching: a multi-armed bandit over variables.
+// Each time a variable is assigned its score moves towards a reward that is
+// 1 / (conflicts since it was last in one), full weight if the assignment
+// ran into a conflict and 90% otherwise.  The step size starts at 0.4 and
+// falls to 0.06 as the search goes on.
+class ChbBrancher : public Brancher {
+	std::vector<double> mScores;
+	std::vector<long> mLastConflict;
+	long mnConflicts;
+	double mStep;
+	VarOrder mOrder;
+
+public:
+	ChbBrancher(const int nVars) : mOrder(mScores) {
+		mScores.assign(nVars, 0);
+		mLastConflict.assign(nVars, 0);
+		mnConflicts = 0;
+		mStep = 0.4;
+		mOrder.init(nVars);
+	}
+
+	void bump(const int var) {
+		mLastConflict[var] = mnConflicts;
+	}
+
+	void conflictDone(const LitValues &/*values*/) {
+		mnConflicts++;
+		if (mStep > 0.06) mStep -= 1e-6;
+	}
+
+	void assigned(const std::vector<Lit> &trail, const size_t first, const bool conflict) {
+		const double multiplier = conflict ? 1.0 : 0.9;
+		for (size_t i = first; i < trail.size(); i++) {
+			const int var = litVar(trail[i]);
+			const double reward = multiplier / (double)(mnConflicts - mLastConflict[var] + 1);
+			mScores[var] = (1 - mStep) * mScores[var] + mStep * reward;
+			mOrder.changed(var);
+		}
+	}
+
+	void unassigned(const int var) {
+		mOrder.insert(var);
+	}
+
+	int pick(const LitValues &values) {
+		return mOrder.pick(values);
+	}
+
+	int peek(const LitValues &values) {
+		return mOrder.peek(values);
+	}
+
+	bool before(const int a, const int b) const {
+		return mOrder.before(a, b);
+	}
+
+	void addVar() {
+		mScores.push_back(0);
+		mLastConflict.push_back(mnConflicts);
+		mOrder.addVar();
+	}
+};
+
+static Brancher *newBrancher(const Heuristic heuristic, const int nVars) {
+	switch (heuristic) {
+	case H_Vmtf:
+		return new VmtfBrancher(nVars);
+	case H_Chb:
+		return new ChbBrancher(nVars);
+	default:
+		return new VsidsBrancher(nVars);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Restarts
+// A restart takes back every decision but keeps what was learned, so one bad
+// early decision cannot trap the search in a hopeless subtree.  -r picks when:
+//   luby:      after 100 * 1 1 2 1 1 2 4 1 1 2 ... conflicts
+//   geometric: after 100 conflicts, then 1.5 times as many each time
+//   glucose:   when recent learned clauses are clearly worse than average, ie
+//              the fast moving average of their LBD is well above the slow one
+// The LBD (literal block distance) of a clause is the number of decision
+// levels among its literals -- low LBD clauses are the useful ones.
+
+enum RestartPolicy { RP_None, RP_Luby, RP_Geometric, RP_Glucose };
+
+static RestartPolicy gRestartPolicy = RP_Glucose;
+
+static bool parseRestartPolicy(const std::string &name, RestartPolicy &policy) {
+	static const char *NAMES[] = { "none", "luby", "geometric", "glucose" };
+	const int i = findName(NAMES, sizeof(NAMES) / sizeof(NAMES[0]), name);
+	if (i < 0) return false;
+	policy = (RestartPolicy)i;
+	return true;
+}
+
+enum { RESTART_INTERVAL = 100, GLUCOSE_MIN_CONFLICTS = 50, LBD_FAST_WINDOW = 32, LBD_SLOW_WINDOW = 4096 };
+
+static const double GEOMETRIC_GROWTH = 1.5;
+static const double GLUCOSE_MARGIN = 1.25;
+
+// 1 1 2 1 1 2 4 1 1 2 1 1 2 4 8 ..., i from 0
+static long luby(long i) {
+	long size = 1;
+	int seq = 0;
+	while (size < i + 1) {
+		size = size * 2 + 1;
+		seq++;
+	}
+	while (size - 1 != i) {
+		size = (size - 1) / 2;
+		seq--;
+		i = i % size;
+	}
+	return 1L << seq;
+}
+
+class Restarts {
+	RestartPolicy mPolicy;
+	long mnConflicts;	// Since the last restart
+	long mnRestarts;
+	double mLimit;
+	long mnLbds;
+	double mFastLbd;
+	double mSlowLbd;
+
+	// Bias corrected: the first values are averaged plainly until the window fills
+	static void average(double &avg, const double value, const long n, const int window) {
+		avg += (value - avg) / (double)std::min(n, (long)window);
+	}
+
+public:
+	Restarts(const RestartPolicy policy) {
+		mPolicy = policy;
+		mnConflicts = 0;
+		mnRestarts = 0;
+		mLimit = RESTART_INTERVAL;
+		mnLbds = 0;
+		mFastLbd = 0;
+		mSlowLbd = 0;
+	}
+
+	void conflict(const int lbd) {
+		mnConflicts++;
+		mnLbds++;
+		average(mFastLbd, lbd, mnLbds, LBD_FAST_WINDOW);
+		average(mSlowLbd, lbd, mnLbds, LBD_SLOW_WINDOW);
+	}
+
+	bool due() const {
+		switch (mPolicy) {
+		case RP_Luby:
+		case RP_Geometric:
+			return mnConflicts >= mLimit;
+		case RP_Glucose:
+			return mnConflicts >= GLUCOSE_MIN_CONFLICTS && mFastLbd > GLUCOSE_MARGIN * mSlowLbd;
+		default:
+			return false;
+		}
+	}
+
+	void restarted() {
+		mnConflicts = 0;
+		mnRestarts++;
+		if (mPolicy == RP_Luby) mLimit = (double)RESTART_INTERVAL * luby(mnRestarts);
+		if (mPolicy == RP_Geometric) mLimit *= GEOMETRIC_GROWTH;
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Clause Database
+// Learned clauses would otherwise pile up until propagation crawls and memory
+// runs out, so they are kept in three tiers by LBD:
+//   core  (LBD <= 2): kept for good
+//   tier2 (LBD <= 6): kept while they keep taking part in conflicts
+//   local (the rest): every reduction the less active half is deleted
+// A clause's LBD is recomputed whenever it takes part in a conflict, and a
+// better one promotes it.
+// All clauses live in one flat array of 32-bit words: a three word header
+// (size; tier, flags and LBD; activity) followed by the literals.  A clause
+// is known by the offset of its header, so references are 32 bits and a
+// clause's literals sit next to its header in the cache.  After a reduction
+// the live clauses are copied into a fresh, compact arena; each old header
+// is left pointing at its new place, which is how the watch lists and the
+// reasons are moved over.
+
+enum ClauseTier { CT_Original, CT_Core, CT_Tier2, CT_Local };
+
+enum { CORE_LBD = 2, TIER2_LBD = 6, REDUCE_FIRST = 2000, REDUCE_INCREMENT = 300 };
+
+static const double CLAUSE_DECAY = 0.999;
+static const double CLAUSE_ACTIVITY_LIMIT = 1e20;
+
+inline ClauseTier tierForLbd(const int lbd) {
+	return lbd <= CORE_LBD ? CT_Core : lbd <= TIER2_LBD ? CT_Tier2 : CT_Local;
+}
+
+typedef uint32_t ClauseRef;	// Offset of the clause's header in the arena
+
+static const ClauseRef NO_REASON = UINT32_MAX;
+
+class ClauseArena {
+	std::vector<uint32_t> mWords;
+	size_t mnWasted;	// Words in deleted clauses
+
+	enum { TIER_MASK = 3, USED_FLAG = 4, DELETED_FLAG = 8, VIVIFIED_FLAG = 16, LBD_SHIFT = 8, MAX_LBD = 0xFFFFFF };
+
+	uint32_t &flags(const ClauseRef ref) { return mWords[ref + 1]; }
+	uint32_t flags(const ClauseRef ref) const { return mWords[ref + 1]; }
+
+public:
+	enum { HEADER_WORDS = 3 };
+
+	ClauseArena() {
+		mnWasted = 0;
+	}
+
+	void reserve(const size_t words) { mWords.reserve(words); }
+	size_t words() const { return mWords.size(); }
+	size_t wasted() const { return mnWasted; }
+
+	void swap(ClauseArena &other) {
+		mWords.swap(other.mWords);
+		std::swap(mnWasted, other.mnWasted);
+	}
+
+	ClauseRef add(const Lit *pLits, const uint32_t n, const ClauseTier tier, const int lbd) {
+		const ClauseRef ref = (ClauseRef)mWords.size();
+		mWords.push_back(n);
+		mWords.push_back(tier | (uint32_t)std::min(lbd, (int)MAX_LBD) << LBD_SHIFT);
+		mWords.push_back(0);
+		mWords.insert(mWords.end(), pLits, pLits + n);
+		setActivity(ref, 0);
+		return ref;
+	}
+
+	// Walks every clause, deleted ones included
+	ClauseRef begin() const { return 0; }
+	ClauseRef end() const { return (ClauseRef)mWords.size(); }
+	ClauseRef next(const ClauseRef ref) const { return ref + HEADER_WORDS + size(ref); }
+
+	uint32_t size(const ClauseRef ref) const { return mWords[ref]; }
+	Lit *lits(const ClauseRef ref) { return &mWords[ref + HEADER_WORDS]; }
+	const Lit *lits(const ClauseRef ref) const { return &mWords[ref + HEADER_WORDS]; }
+
+	ClauseTier tier(const ClauseRef ref) const { return (ClauseTier)(flags(ref) & TIER_MASK); }
+	void setTier(const ClauseRef ref, const ClauseTier tier) { flags(ref) = (flags(ref) & ~(uint32_t)TIER_MASK) | tier; }
+	bool isLearnt(const ClauseRef ref) const { return tier(ref) != CT_Original; }
+
+	int lbd(const ClauseRef ref) const { return (int)(flags(ref) >> LBD_SHIFT); }
+	void setLbd(const ClauseRef ref, const int lbd) {
+		flags(ref) = (flags(ref) & (((uint32_t)1 << LBD_SHIFT) - 1)) | (uint32_t)std::min(lbd, (int)MAX_LBD) << LBD_SHIFT;
+	}
+
+	// Took part in a conflict since the last reduction
+	bool isUsed(const ClauseRef ref) const { return (flags(ref) & USED_FLAG) != 0; }
+	void setUsed(const ClauseRef ref, const bool used) { flags(ref) = used ? flags(ref) | USED_FLAG : flags(ref) & ~(uint32_t)USED_FLAG; }
+
+	bool isVivified(const ClauseRef ref) const { return (flags(ref) & VIVIFIED_FLAG) != 0; }
+	void setVivified(const ClauseRef ref) { flags(ref) |= VIVIFIED_FLAG; }
+
+	bool isDeleted(const ClauseRef ref) const { return (flags(ref) & DELETED_FLAG) != 0; }
+	void markDeleted(const ClauseRef ref) {
+		flags(ref) |= DELETED_FLAG;
+		mnWasted += HEADER_WORDS + size(ref);
+	}
+
+	float activity(const ClauseRef ref) const {
+		float activity;
+		memcpy(&activity, &mWords[ref + 2], sizeof(activity));
+		return activity;
+	}
+	void setActivity(const ClauseRef ref, const float activity) { memcpy(&mWords[ref + 2], &activity, sizeof(activity)); }
+
+	// Copies the clause to the end of to, and leaves its new reference in
+	// place of the activity here
+	void moveTo(const ClauseRef ref, ClauseArena &to) {
+		const ClauseRef moved = (ClauseRef)to.mWords.size();
+		to.mWords.insert(to.mWords.end(), mWords.begin() + ref, mWords.begin() + next(ref));
+		mWords[ref + 2] = moved;
+	}
+	ClauseRef movedTo(const ClauseRef ref) const { return mWords[ref + 2]; }
+};
+
+//-----------------------------------------------------------------------------
+// Phases
+// Which value a decision tries.  Each variable keeps the value it last had
+// (phase saving), so after a backjump or restart the search rebuilds the
+// assignment it had rather than starting over.  Two more assignments are
+// kept: the target, the longest conflict free trail since the last rephase,
+// and the best, the longest one seen at all.  Decisions follow the target
+// where it has a value.  Every REPHASE_INTERVAL * n conflicts the saved
+// phases are reset, in turn, to the best, the original (all true), the best,
+// the inverse, the best, random, the best, and the result of a short local
+// search walk, so the search does not keep re-exploring one region.
+
+enum Rephase { RE_Original, RE_Inverted, RE_Best, RE_Random, RE_Walk };
+
+static const Rephase REPHASE_CYCLE[] = { RE_Best, RE_Original, RE_Best, RE_Inverted, RE_Best, RE_Random, RE_Best, RE_Walk };
+
+enum { REPHASE_INTERVAL = 1000, WALK_FLIPS_PER_CLAUSE = 10, WALK_NOISE_PERCENT = 50 };
+
+static const bool ORIGINAL_PHASE = true;
+
+// xorshift64*, small and the same everywhere, so runs are repeatable
+class Random {
+	uint64_t mState;
+
+public:
+	Random(const uint64_t seed) {
+		mState = seed == 0 ? 1 : seed;
+	}
+
+	uint64_t next() {
+		mState ^= mState >> 12;
+		mState ^= mState << 25;
+		mState ^= mState >> 27;
+		return mState * 0x2545F4914F6CDD1DULL;
+	}
+
+	// 0 to n - 1
+	uint32_t below(const uint32_t n) {
+		return (uint32_t)((next() >> 32) % n);
+	}
+};
+
+// WalkSAT from phases over clauses, leaving in phases the assignment with
+// the fewest unsatisfied clauses it found.  Variables that are already
+// assigned in fixed (level 0) are never flipped.
+static void walkPhases(const ClauseArena &arena, const LitValues &fixed, std::vector<char> &phases, Random &random) {
+	std::vector<ClauseRef> clauses;
+	for (ClauseRef ref = arena.begin(); ref != arena.end(); ref = arena.next(ref)) {
+		if (!arena.isLearnt(ref) && !arena.isDeleted(ref)) clauses.push_back(ref);
+	}
+	const size_t nClauses = clauses.size();
+
+	const int nVars = (int)phases.size();
+	std::vector<char> value(phases);
+	for (int var = 0; var < nVars; var++) {
+		if (fixed.get(var) != LV_Unassigned) value[var] = fixed.isTrue(var);
+	}
+	auto isTrue = [&value](const Lit lit) { return value[litVar(lit)] != (litNegated(lit) ? 1 : 0); };
+
+	std::vector<std::vector<int>> occurs(nVars * 2);
+	std::vector<int> nTrue(nClauses, 0);
+	std::vector<int> unsat;
+	std::vector<int> unsatPos(nClauses, -1);
+	for (size_t ci = 0; ci < nClauses; ci++) {
+		const Lit *c = arena.lits(clauses[ci]);
+		for (const Lit *it = c; it != c + arena.size(clauses[ci]); it++) {
+			occurs[*it].push_back((int)ci);
+			if (isTrue(*it)) nTrue[ci]++;
+		}
+		if (nTrue[ci] == 0) {
+			unsatPos[ci] = (int)unsat.size();
+			unsat.push_back((int)ci);
+		}
+	}
+
+	size_t bestUnsat = unsat.size();
+	std::vector<char> best(value);
+	const long nFlips = (long)nClauses * WALK_FLIPS_PER_CLAUSE;
+	for (long flip = 0; flip < nFlips && !unsat.empty(); flip++) {
+		const ClauseRef ref = clauses[unsat[random.below((uint32_t)unsat.size())]];
+		const Lit *c = arena.lits(ref);
+		const Lit *cEnd = c + arena.size(ref);
+
+		// The literal whose flip breaks the fewest clauses, or sometimes any
+		Lit pick = NO_LIT;
+		int pickBreaks = INT32_MAX;
+		int nFree = 0;
+		for (const Lit *it = c; it != cEnd; it++) {
+			if (fixed.get(litVar(*it)) != LV_Unassigned) continue;
+			nFree++;
+			int breaks = 0;
+			const std::vector<int> &falsified = occurs[litNot(*it)];
+			for (auto jt = falsified.begin(); jt != falsified.end(); jt++) {
+				if (nTrue[*jt] == 1) breaks++;
+			}
+			if (breaks < pickBreaks) {
+				pick = *it;
+				pickBreaks = breaks;
+			}
+		}
+		if (nFree == 0) break;
+		if (pickBreaks > 0 && (int)random.below(100) < WALK_NOISE_PERCENT) {
+			int k = (int)random.below((uint32_t)nFree);
+			for (const Lit *it = c; it != cEnd; it++) {
+				if (fixed.get(litVar(*it)) != LV_Unassigned) continue;
+				if (k-- == 0) pick = *it;
+			}
+		}
+
+		value[litVar(pick)] = !litNegated(pick);
+		const std::vector<int> &satisfied = occurs[pick];
+		for (auto it = satisfied.begin(); it != satisfied.end(); it++) {
+			if (nTrue[*it]++ > 0) continue;
+			const int last = unsat.back();
+			unsat[unsatPos[*it]] = last;
+			unsatPos[last] = unsatPos[*it];
+			unsat.pop_back();
+			unsatPos[*it] = -1;
+		}
+		const std::vector<int> &falsified = occurs[litNot(pick)];
+		for (auto it = falsified.begin(); it != falsified.end(); it++) {
+			if (--nTrue[*it] > 0) continue;
+			unsatPos[*it] = (int)unsat.size();
+			unsat.push_back(*it);
+		}
+
+		if (unsat.size() < bestUnsat) {
+			bestUnsat = unsat.size();
+			best = value;
+		}
+	}
+	phases.swap(best);
+}
+
+//-----------------------------------------------------------------------------
+// Subsumption
+// A clause C subsumes D when all of C's literals are in D, and then D can go.
+// When all but one are, and D has that one negated, D can lose it instead
+// (self-subsuming resolution).  Each clause has a 64-bit signature, bit
+// var % 64 for each of its variables, so most pairs are ruled out with one
+// AND before any literals are compared.  Candidates for D come from the
+// occurrence lists, both signs, of C's rarest variable.
+
+static const long SUBSUME_STEPS = 10 * MEGA;	// Literals compared per pass
+
+enum Subsumption { SU_None, SU_Subsumes, SU_Strengthens };
+
+inline uint64_t clauseSignature(const Lit *pLits, const size_t n) {
+	uint64_t signature = 0;
+	for (const Lit *it = pLits; it != pLits + n; it++) {
+		signature |= (uint64_t)1 << (litVar(*it) & 63);
+	}
+	return signature;
+}
+
+// How C, whose literals are set in marks, relates to D.  For SU_Strengthens,
+// lost is the literal D can drop.
+static Subsumption subsumes(const std::vector<char> &marks, const size_t cSize, const Lit *pD, const size_t dSize, Lit &lost) {
+	if (dSize < cSize) return SU_None;
+	size_t nFound = 0;
+	size_t nNegated = 0;
+	for (const Lit *it = pD; it != pD + dSize; it++) {
+		if (marks[*it]) {
+			nFound++;
+		}
+		else if (marks[litNot(*it)]) {
+			nNegated++;
+			lost = *it;
+		}
+	}
+	if (nFound == cSize) return SU_Subsumes;
+	if (nFound + 1 == cSize && nNegated == 1) return SU_Strengthens;
+	return SU_None;
+}
+
+// The clauses a subsumption pass works over, by index
+class SubsumeClauses {
+public:
+	virtual ~SubsumeClauses() {
+	}
+
+	// The literals of a clause, or null if it is gone
+	virtual const Lit *lits(const uint32_t index, size_t &size) const = 0;
+};
+
+// Clauses held one vector each, as the Eliminator does
+class VectorClauses : public SubsumeClauses {
+	const Clauses &mClauses;
+	const std::vector<char> &mRemoved;
+
+public:
+	VectorClauses(const Clauses &clauses, const std::vector<char> &removed) : mClauses(clauses), mRemoved(removed) {
+	}
+
+	const Lit *lits(const uint32_t index, size_t &size) const {
+		if (mRemoved[index]) return nullptr;
+		size = mClauses[index].size();
+		return mClauses[index].data();
+	}
+};
+
+// Clauses in an arena, numbered by their place in refs
+class ArenaClauses : public SubsumeClauses {
+	const ClauseArena &mArena;
+	const std::vector<ClauseRef> &mRefs;
+
+public:
+	ArenaClauses(const ClauseArena &arena, const std::vector<ClauseRef> &refs) : mArena(arena), mRefs(refs) {
+	}
+
+	const Lit *lits(const uint32_t index, size_t &size) const {
+		if (mArena.isDeleted(mRefs[index])) return nullptr;
+		size = mArena.size(mRefs[index]);
+		return mArena.lits(mRefs[index]);
+	}
+};
+
+// Finds the clauses that clause ci subsumes, and those it strengthens along
+// with the literal each loses.  Nothing is changed, since that would change
+// the occurrence lists being walked, so the caller applies both.  marks is
+// by literal and left clear.  Returns the number of literals compared.
+static long findSubsumed(const SubsumeClauses &clauses, const std::vector<std::vector<uint32_t>> &occurs, const std::vector<uint64_t> &signatures,
+		std::vector<char> &marks, const uint32_t ci, std::vector<uint32_t> &subsumed, std::vector<std::pair<uint32_t, Lit>> &strengthened) {
+	subsumed.clear();
+	strengthened.clear();
+	size_t cSize = 0;
+	const Lit *pC = clauses.lits(ci, cSize);
+	Lit rarest = pC[0];
+	for (const Lit *it = pC; it != pC + cSize; it++) {
+		if (occurs[*it].size() + occurs[litNot(*it)].size() < occurs[rarest].size() + occurs[litNot(rarest)].size()) rarest = *it;
+		marks[*it] = true;
+	}
+
+	long nSteps = 0;
+	for (int sign = 0; sign < 2; sign++) {
+		const std::vector<uint32_t> &candidates = occurs[sign == 0 ? rarest : litNot(rarest)];
+		for (auto it = candidates.begin(); it != candidates.end(); it++) {
+			if (*it == ci || (signatures[ci] & ~signatures[*it]) != 0) continue;
+			size_t dSize = 0;
+			const Lit *pD = clauses.lits(*it, dSize);
+			if (pD == nullptr) continue;
+			nSteps += (long)dSize;
+			Lit lost = NO_LIT;
+			const Subsumption subsumption = subsumes(marks, cSize, pD, dSize, lost);
+			if (subsumption == SU_Subsumes) {
+				subsumed.push_back(*it);
+			}
+			else if (subsumption == SU_Strengthens) {
+				strengthened.push_back(std::make_pair(*it, lost));
+			}
+		}
+	}
+	for (const Lit *it = pC; it != pC + cSize; it++) {
+		marks[*it] = false;
+	}
+	return nSteps;
+}
+
+//-----------------------------------------------------------------------------
+// Symmetry
+// Swapping two pigeons, or two holes, maps a pigeonhole formula onto itself,
+// and without help the search refutes every one of those copies separately.
+// Symmetries of the clauses are found as automorphisms of a colored graph:
+// a vertex for each literal, joined to its negation, and a vertex for each
+// clause, joined to its literals.  Refinement splits the vertices into cells
+// by how many neighbors they have in each other cell.  Then, down one path
+// as nauty does, the smallest vertex u of the first cell is given a cell of
+// its own; afterwards, from the deepest level up, an automorphism fixing the
+// path above and taking u to v is searched for each v in u's cell that the
+// ones found so far cannot already reach.  The automorphisms found generate
+// the group, or a part of it if the budget runs out.  The eliminator gives
+// each one, g, lex-leader clauses: the assignment, read over the variables g
+// moves in order, is no larger than its image under g, which still allows
+// the smallest model in every family of symmetric ones.
+
+enum { SYMMETRY_LEX_VARS = 100 };	// Of the variables a generator moves, how many the clauses cover
+
+static const long SYMMETRY_MAX_VERTICES = 200 * KILO;
+static const long SYMMETRY_STEPS = 20 * MEGA;	// Vertices and edges visited
+static const long SYMMETRY_PATH_VERTICES = 2 * MEGA;	// Partitions kept down a path, times their size
+
+// An ordered partition of the vertices: each cell is a run of mOrder, and a
+// vertex's color is where its cell starts
+class Partition {
+public:
+	std::vector<uint32_t> mOrder;
+	std::vector<uint32_t> mPositions;	// By vertex, in mOrder
+	std::vector<uint32_t> mCells;	// By vertex
+	std::vector<uint32_t> mSizes;	// By cell start
+	uint32_t mnCells;
+
+	Partition() {
+		mnCells = 0;
+	}
+};
+
+class SymmetryFinder {
+	const int mnFormulaVars;
+	std::vector<int> mVars;	// By vertex variable, the formula's
+	uint32_t mnLitVertices;
+	uint32_t mnVertices;
+	std::vector<uint32_t> mStarts;	// Neighbors of v are mNeighbors[mStarts[v]..mStarts[v + 1]]
+	std::vector<uint32_t> mNeighbors;
+	std::vector<uint32_t> mHits;	// By vertex, neighbors in the splitter
+	std::vector<uint32_t> mHitVertices;
+	std::vector<uint32_t> mHitCells;
+	std::vector<uint32_t> mCellHits;	// By cell start, how many vertices the splitter hits
+	std::vector<uint32_t> mSplitterVertices;
+	std::vector<char> mQueued;	// By cell start
+	std::vector<uint32_t> mSplitters;
+	std::vector<char> mMarks;	// By vertex
+	std::vector<char> mImages;	// By vertex
+	std::vector<std::pair<uint64_t, uint32_t>> mClauseHashes;	// Sorted, with their vertices
+	long mnSteps;
+
+	void move(Partition &p, const uint32_t v, const uint32_t position) {
+		const uint32_t other = p.mOrder[position];
+		p.mOrder[p.mPositions[v]] = other;
+		p.mPositions[other] = p.mPositions[v];
+		p.mOrder[position] = v;
+		p.mPositions[v] = position;
+	}
+
+	// Splits every cell by how many neighbors each of its vertices has in
+	// a splitter cell, until no splitter is left.  The vertices a splitter
+	// hits gather at the back of their cells, so only they are sorted and
+	// relabeled.  The fragments go in order of that count and all but the
+	// largest become splitters, so isomorphic partitions come out isomorphic.
+	void refine(Partition &p) {
+		for (size_t q = 0; q < mSplitters.size(); q++) {
+			const uint32_t splitter = mSplitters[q];
+			mQueued[splitter] = false;
+			mSplitterVertices.assign(p.mOrder.begin() + splitter, p.mOrder.begin() + splitter + p.mSizes[splitter]);
+			for (auto it = mSplitterVertices.begin(); it != mSplitterVertices.end(); it++) {
+				const uint32_t w = *it;
+				mnSteps += mStarts[w + 1] - mStarts[w];
+				for (uint32_t k = mStarts[w]; k < mStarts[w + 1]; k++) {
+					const uint32_t x = mNeighbors[k];
+					if (mHits[x]++ > 0) continue;
+					mHitVertices.push_back(x);
+					const uint32_t cell = p.mCells[x];
+					if (p.mSizes[cell] == 1) continue;
+					if (mCellHits[cell]++ == 0) mHitCells.push_back(cell);
+					move(p, x, cell + p.mSizes[cell] - mCellHits[cell]);
+				}
+			}
+			std::sort(mHitCells.begin(), mHitCells.end());
+
+			for (auto it = mHitCells.begin(); it != mHitCells.end(); it++) {
+				const uint32_t cell = *it;
+				const uint32_t end = cell + p.mSizes[cell];
+				const uint32_t hitStart = end - mCellHits[cell];
+				mCellHits[cell] = 0;
+				const std::vector<uint32_t> &hits = mHits;
+				std::sort(p.mOrder.begin() + hitStart, p.mOrder.begin() + end, [&hits](uint32_t a, uint32_t b) {
+					return hits[a] < hits[b];
+				});
+				for (uint32_t i = hitStart; i < end; i++) {
+					p.mPositions[p.mOrder[i]] = i;
+				}
+				mnSteps += end - hitStart;
+				if (hitStart == cell && mHits[p.mOrder[cell]] == mHits[p.mOrder[end - 1]]) continue;
+
+				// The unhit vertices, if any, keep the cell's start
+				const bool wasQueued = mQueued[cell] != 0;
+				uint32_t largest = cell;
+				uint32_t start = cell;
+				for (uint32_t i = hitStart; i <= end; i++) {
+					if (i < end && (i == start || mHits[p.mOrder[i]] == mHits[p.mOrder[start]])) {
+						p.mCells[p.mOrder[i]] = start;
+						continue;
+					}
+					p.mSizes[start] = i - start;
+					if (start != cell) p.mnCells++;
+					if (p.mSizes[start] > p.mSizes[largest]) largest = start;
+					start = i;
+					if (i < end) p.mCells[p.mOrder[i]] = start;
+				}
+				for (uint32_t fragment = cell; fragment < end; fragment += p.mSizes[fragment]) {
+					if (mQueued[fragment] || (!wasQueued && fragment == largest)) continue;
+					mQueued[fragment] = true;
+					mSplitters.push_back(fragment);
+				}
+			}
+			for (auto it = mHitVertices.begin(); it != mHitVertices.end(); it++) {
+				mHits[*it] = 0;
+			}
+			mHitVertices.clear();
+			mHitCells.clear();
+		}
+		mSplitters.clear();
+	}
+
+	// Gives v a cell of its own, at the back of its old one, and refines
+	void individualize(Partition &p, const uint32_t v) {
+		const uint32_t cell = p.mCells[v];
+		const uint32_t last = cell + p.mSizes[cell] - 1;
+		move(p, v, last);
+		p.mSizes[cell]--;
+		p.mSizes[last] = 1;
+		p.mCells[v] = last;
+		p.mnCells++;
+		mQueued[last] = true;
+		mSplitters.push_back(last);
+		refine(p);
+	}
+
+	// Where the first cell of more than one vertex starts, or UINT32_MAX
+	static uint32_t firstCell(const Partition &p) {
+		for (uint32_t cell = 0; cell < p.mOrder.size(); cell += p.mSizes[cell]) {
+			if (p.mSizes[cell] > 1) return cell;
+		}
+		return UINT32_MAX;
+	}
+
+	// Its smallest vertex, which keeps the generators close to the identity
+	static uint32_t smallest(const Partition &p, const uint32_t cell) {
+		return *std::min_element(p.mOrder.begin() + cell, p.mOrder.begin() + cell + p.mSizes[cell]);
+	}
+
+	static bool sameCells(const Partition &a, const Partition &b) {
+		if (a.mnCells != b.mnCells) return false;
+		for (uint32_t cell = 0; cell < a.mOrder.size(); cell += a.mSizes[cell]) {
+			if (b.mCells[b.mOrder[cell]] != cell || b.mSizes[cell] != a.mSizes[cell]) return false;
+		}
+		return true;
+	}
+
+	bool isAutomorphism(const std::vector<uint32_t> &perm) {
+		mnSteps += (long)mNeighbors.size();
+		for (uint32_t v = 0; v < mnVertices; v++) {
+			const uint32_t image = perm[v];
+			if (mStarts[v + 1] - mStarts[v] != mStarts[image + 1] - mStarts[image]) return false;
+			for (uint32_t i = mStarts[image]; i < mStarts[image + 1]; i++) {
+				mMarks[mNeighbors[i]] = true;
+			}
+			bool ok = true;
+			for (uint32_t i = mStarts[v]; i < mStarts[v + 1] && ok; i++) {
+				ok = mMarks[perm[mNeighbors[i]]] != 0;
+			}
+			for (uint32_t i = mStarts[image]; i < mStarts[image + 1]; i++) {
+				mMarks[mNeighbors[i]] = false;
+			}
+			if (!ok) return false;
+		}
+		return true;
+	}
+
+	static uint64_t mix(uint64_t x) {
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53ULL;
+		return x ^ (x >> 33);
+	}
+
+	// Of the clause vertex's literals, mapped by perm
+	uint64_t clauseHash(const uint32_t vertex, const std::vector<uint32_t> &perm) const {
+		uint64_t hash = 0;
+		for (uint32_t i = mStarts[vertex]; i < mStarts[vertex + 1]; i++) {
+			hash += mix(perm[mNeighbors[i]]);
+		}
+		return hash;
+	}
+
+	// Maps a's literal singletons to b's and tries the permutation of the
+	// literals that moves nothing else it need not: every literal that is not
+	// an image stays put, and each chain x -> y -> ... that runs off the
+	// mapped ones closes back into a cycle.  The literals say where each
+	// clause goes.  That finds a symmetry which moves little, like a swap of
+	// two pigeons, without searching further, and it is the whole of the
+	// check once every vertex has its own cell.
+	bool trySparse(const Partition &a, const Partition &b, std::vector<uint32_t> &perm) {
+		mnSteps += mnVertices + (long)mNeighbors.size();
+		std::fill(perm.begin(), perm.end(), UINT32_MAX);
+		for (uint32_t cell = 0; cell < mnLitVertices; cell += a.mSizes[cell]) {
+			if (a.mSizes[cell] > 1) continue;
+			perm[a.mOrder[cell]] = b.mOrder[cell];
+			mImages[b.mOrder[cell]] = true;
+		}
+		for (uint32_t v = 0; v < mnLitVertices; v++) {
+			if (perm[v] == UINT32_MAX && !mImages[v]) {
+				perm[v] = v;
+				mImages[v] = true;
+			}
+		}
+		for (uint32_t v = 0; v < mnLitVertices; v++) {
+			if (mImages[v]) continue;
+			uint32_t end = v;
+			while (perm[end] != UINT32_MAX) end = perm[end];
+			perm[end] = v;
+		}
+		std::fill(mImages.begin(), mImages.begin() + mnLitVertices, false);
+
+		bool ok = true;
+		for (uint32_t v = mnLitVertices; v < mnVertices && ok; v++) {
+			const uint64_t hash = clauseHash(v, perm);
+			auto it = std::lower_bound(mClauseHashes.begin(), mClauseHashes.end(), std::make_pair(hash, (uint32_t)0));
+			for (; it != mClauseHashes.end() && it->first == hash; it++) {
+				if (!mImages[it->second] && mStarts[it->second + 1] - mStarts[it->second] == mStarts[v + 1] - mStarts[v]) break;
+			}
+			ok = it != mClauseHashes.end() && it->first == hash;
+			if (ok) {
+				perm[v] = it->second;
+				mImages[it->second] = true;
+			}
+		}
+		std::fill(mImages.begin() + mnLitVertices, mImages.end(), false);
+		return ok && isAutomorphism(perm);
+	}
+
+	// Searches for an automorphism taking the refined partition a to b by
+	// individualizing the smallest vertex u of a's first cell, trying each
+	// vertex of the same cell in b, u itself and then the smallest first,
+	// with its own stack of what is left to try
+	bool findAutomorphism(const Partition &a, const Partition &b, std::vector<uint32_t> &perm) {
+		std::vector<Partition> aPath(1, a);
+		std::vector<Partition> bPath(1, b);
+		std::vector<std::vector<uint32_t>> untried(1);
+		std::vector<uint32_t> us(1);
+		bool descend = true;
+		while (!untried.empty() && mnSteps < SYMMETRY_STEPS) {
+			const size_t depth = untried.size() - 1;
+			if ((long)(depth + 1) * mnVertices > SYMMETRY_PATH_VERTICES) return false;
+			if (descend) {
+				descend = false;
+				mnSteps += mnVertices;
+				if (!sameCells(aPath[depth], bPath[depth])) {
+					untried.pop_back();
+					continue;
+				}
+				if (trySparse(aPath[depth], bPath[depth], perm)) return true;
+				const uint32_t cell = firstCell(aPath[depth]);
+				if (cell == UINT32_MAX) {
+					untried.pop_back();
+					continue;
+				}
+				us[depth] = smallest(aPath[depth], cell);
+				const Partition &p = bPath[depth];
+				std::vector<uint32_t> &vs = untried[depth];
+				vs.assign(p.mOrder.begin() + cell, p.mOrder.begin() + cell + p.mSizes[cell]);
+				std::sort(vs.rbegin(), vs.rend());
+				const auto it = std::find(vs.begin(), vs.end(), us[depth]);
+				if (it != vs.end()) std::rotate(it, it + 1, vs.end());
+			}
+			if (untried[depth].empty()) {
+				untried.pop_back();
+				continue;
+			}
+
+			const uint32_t v = untried[depth].back();
+			untried[depth].pop_back();
+			mnSteps += mnVertices;
+			aPath.resize(depth + 2);
+			bPath.resize(depth + 2);
+			aPath[depth + 1] = aPath[depth];
+			bPath[depth + 1] = bPath[depth];
+			individualize(aPath[depth + 1], us[depth]);
+			individualize(bPath[depth + 1], v);
+			untried.push_back(std::vector<uint32_t>());
+			us.push_back(0);
+			descend = true;
+		}
+		return false;
+	}
+
+	Lit vertexLit(const uint32_t vertex) const {
+		return mkLit(mVars[litVar(vertex)], litNegated(vertex));
+	}
+
+	static uint32_t findRoot(std::vector<uint32_t> &parents, uint32_t v) {
+		while (parents[v] != v) {
+			v = parents[v] = parents[parents[v]];
+		}
+		return v;
+	}
+
+public:
+	// Only the variables in some clause get vertices, so the eliminated and
+	// fixed ones stay where they are
+	SymmetryFinder(const int nVars, const Clauses &clauses) : mnFormulaVars(nVars) {
+		std::vector<int> vertexVars(nVars, -1);
+		for (auto it = clauses.begin(); it != clauses.end(); it++) {
+			for (auto jt = it->begin(); jt != it->end(); jt++) {
+				if (vertexVars[litVar(*jt)] >= 0) continue;
+				vertexVars[litVar(*jt)] = (int)mVars.size();
+				mVars.push_back(litVar(*jt));
+			}
+		}
+		mnLitVertices = (uint32_t)mVars.size() * 2;
+		mnVertices = mnLitVertices + (uint32_t)clauses.size();
+		std::vector<uint32_t> degrees(mnVertices, 0);
+		for (uint32_t lit = 0; lit < mnLitVertices; lit++) {
+			degrees[lit]++;
+		}
+		for (size_t i = 0; i < clauses.size(); i++) {
+			degrees[mnLitVertices + i] += (uint32_t)clauses[i].size();
+			for (auto it = clauses[i].begin(); it != clauses[i].end(); it++) {
+				degrees[mkLit(vertexVars[litVar(*it)], litNegated(*it))]++;
+			}
+		}
+		mStarts.assign(mnVertices + 1, 0);
+		for (uint32_t v = 0; v < mnVertices; v++) {
+			mStarts[v + 1] = mStarts[v] + degrees[v];
+		}
+		mNeighbors.resize(mStarts[mnVertices]);
+		std::vector<uint32_t> ends(mStarts.begin(), mStarts.end() - 1);
+		for (uint32_t lit = 0; lit < mnLitVertices; lit++) {
+			mNeighbors[ends[lit]++] = litNot(lit);
+		}
+		for (size_t i = 0; i < clauses.size(); i++) {
+			const uint32_t vertex = mnLitVertices + (uint32_t)i;
+			for (auto it = clauses[i].begin(); it != clauses[i].end(); it++) {
+				const Lit lit = mkLit(vertexVars[litVar(*it)], litNegated(*it));
+				mNeighbors[ends[vertex]++] = lit;
+				mNeighbors[ends[lit]++] = vertex;
+			}
+		}
+		mHits.assign(mnVertices, 0);
+		mCellHits.assign(mnVertices, 0);
+		mQueued.assign(mnVertices, false);
+		mMarks.assign(mnVertices, false);
+		mImages.assign(mnVertices, false);
+		std::vector<uint32_t> identity(mnLitVertices);
+		for (uint32_t lit = 0; lit < mnLitVertices; lit++) {
+			identity[lit] = lit;
+		}
+		for (uint32_t v = mnLitVertices; v < mnVertices; v++) {
+			mClauseHashes.push_back(std::make_pair(clauseHash(v, identity), v));
+		}
+		std::sort(mClauseHashes.begin(), mClauseHashes.end());
+		mnSteps = 0;
+	}
+
+	// Generators of the formula's symmetries, as permutations of literals
+	void findGenerators(std::vector<std::vector<Lit>> &generators) {
+		if (mnVertices > SYMMETRY_MAX_VERTICES) return;
+		// Literals, then clauses
+		Partition root;
+		root.mOrder.resize(mnVertices);
+		for (uint32_t v = 0; v < mnVertices; v++) {
+			root.mOrder[v] = v;
+		}
+		root.mPositions = root.mOrder;
+		root.mCells.resize(mnVertices);
+		root.mSizes.assign(mnVertices, 0);
+		root.mnCells = 0;
+		for (uint32_t v = 0; v < mnVertices; v++) {
+			const uint32_t start = v < mnLitVertices ? 0 : mnLitVertices;
+			if (v == start) {
+				root.mnCells++;
+				mQueued[start] = true;
+				mSplitters.push_back(start);
+			}
+			root.mCells[v] = start;
+			root.mSizes[start]++;
+		}
+		refine(root);
+
+		// The first path: individualize the smallest vertex of the first cell
+		// with more than one until each vertex has its own cell
+		std::vector<Partition> path(1, root);
+		std::vector<uint32_t> us;
+		while (mnSteps < SYMMETRY_STEPS && (long)path.size() * mnVertices < SYMMETRY_PATH_VERTICES) {
+			const uint32_t cell = firstCell(path.back());
+			if (cell == UINT32_MAX) break;
+			us.push_back(smallest(path.back(), cell));
+			mnSteps += mnVertices;
+			path.push_back(path.back());
+			individualize(path.back(), us.back());
+		}
+
+		// Deepest first, since what was found below also fixes the path
+		// down to here, and its orbits say which v need no search
+		std::vector<uint32_t> perm(mnVertices);
+		std::vector<uint32_t> orbits(mnVertices);
+		for (uint32_t v = 0; v < mnVertices; v++) {
+			orbits[v] = v;
+		}
+		Partition image;
+		for (size_t level = us.size(); level-- > 0 && mnSteps < SYMMETRY_STEPS;) {
+			const uint32_t u = us[level];
+			const Partition &p = path[level];
+			const uint32_t cell = p.mCells[u];
+			std::vector<uint32_t> vs(p.mOrder.begin() + cell, p.mOrder.begin() + cell + p.mSizes[cell]);
+			std::sort(vs.begin(), vs.end());
+			for (auto it = vs.begin(); it != vs.end() && mnSteps < SYMMETRY_STEPS; it++) {
+				const uint32_t v = *it;
+				if (findRoot(orbits, v) == findRoot(orbits, u)) continue;
+				image = p;
+				mnSteps += mnVertices;
+				individualize(image, v);
+				if (!findAutomorphism(path[level + 1], image, perm)) continue;
+
+				std::vector<Lit> generator(mnFormulaVars * 2);
+				for (Lit lit = 0; lit < (Lit)generator.size(); lit++) {
+					generator[lit] = lit;
+				}
+				for (Lit lit = 0; lit < mnLitVertices; lit++) {
+					generator[vertexLit(lit)] = vertexLit(perm[lit]);
+				}
+				generators.push_back(generator);
+				for (uint32_t x = 0; x < mnVertices; x++) {
+					orbits[findRoot(orbits, x)] = findRoot(orbits, perm[x]);
+				}
+			}
+		}
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Variable Elimination
+// Before the search, variables are eliminated by clause distribution
+// (SatELite): the clauses with x and the clauses with ~x are replaced by all
+// their non-tautological resolvents on x, as long as there are no more of
+// those than clauses removed.  Most Tseitin gate variables go this way, since
+// a gate only links its inputs to its users.  Units found on the way are
+// propagated.  The removed clauses are kept on a stack, and once the rest is
+// solved they are replayed in reverse, giving each eliminated variable a
+// value that satisfies its clauses.  New and shortened clauses are used
+// for backward subsumption between the rounds.
+// Last, bounded variable addition goes the other way.  Where clauses form a
+// product, (l1 | R1) (l1 | R2) (l2 | R1) (l2 | R2) ..., every li with every
+// Rj, a fresh variable x stands in for it: (li | x) for each i and (~x | Rj)
+// for each j.  An at-most-one constraint written pairwise shrinks from
+// O(n^2) binary clauses to O(n).  The fresh variables are not in the formula,
+// so the model needs nothing for them.
+
+enum { ELIM_MAX_RESOLVENT = 24 };
+
+static const long ADD_STEPS = 20 * MEGA;	// Literals visited matching, for the whole run
+
+static const long ELIM_STEPS = 20 * MEGA;	// Literals visited resolving, for the whole run
+
+// Variables with more clauses than this on either side are kept, 0 turns
+// elimination off
+static int gElimOccurrences = 16;
+
+class Eliminator {
+	int mnVars;
+	Clauses mClauses;
+	std::vector<char> mRemoved;	// By clause
+	std::vector<uint64_t> mSignatures;	// By clause
+	std::vector<uint32_t> mSubsumeQueue;	// Clauses to subsume others with
+	std::vector<std::vector<uint32_t>> mOccurs;	// Clause indexes by literal, removed ones dropped lazily
+	std::vector<uint8_t> mValues;	// LitValue by variable, of units
+	std::vector<Lit> mUnits;	// To propagate
+	std::vector<char> mEliminated;
+	std::vector<char> mMarks;	// By literal, for resolving
+	std::vector<char> mTouched;	// By variable, to try again next round
+	std::vector<uint32_t> mCounts;	// By literal, for matching
+	Clauses mResolvents;
+	long mnSteps;
+
+	// Each clause removed by elimination, its eliminated literal first,
+	// followed by its size
+	std::vector<Lit> mStack;
+
+	void addClause(Clause &c) {
+		const uint32_t index = (uint32_t)mClauses.size();
+		for (auto it = c.begin(); it != c.end(); it++) {
+			mOccurs[*it].push_back(index);
+			mTouched[litVar(*it)] = true;
+		}
+		mSignatures.push_back(clauseSignature(c.data(), c.size()));
+		mSubsumeQueue.push_back(index);
+		mClauses.push_back(Clause());
+		mClauses.back().swap(c);
+		mRemoved.push_back(false);
+	}
+
+	// False if it contradicts an earlier unit
+	bool addUnit(const Lit lit) {
+		const uint8_t value = mValues[litVar(lit)];
+		if (value != LV_Unassigned) return value == (litNegated(lit) ? LV_False : LV_True);
+		mValues[litVar(lit)] = litNegated(lit) ? LV_False : LV_True;
+		mUnits.push_back(lit);
+		return true;
+	}
+
+	// Removes the clauses units satisfy and strips the literals they falsify
+	bool propagate() {
+		while (!mUnits.empty()) {
+			const Lit lit = mUnits.back();
+			mUnits.pop_back();
+
+			std::vector<uint32_t> &satisfied = mOccurs[lit];
+			for (auto it = satisfied.begin(); it != satisfied.end(); it++) {
+				mRemoved[*it] = true;
+			}
+			satisfied.clear();
+
+			std::vector<uint32_t> &falsified = mOccurs[litNot(lit)];
+			for (auto it = falsified.begin(); it != falsified.end(); it++) {
+				if (mRemoved[*it]) continue;
+				Clause &c = mClauses[*it];
+				c.erase(std::find(c.begin(), c.end(), litNot(lit)));
+				for (auto jt = c.begin(); jt != c.end(); jt++) {
+					mTouched[litVar(*jt)] = true;
+				}
+				if (c.empty()) return false;
+				if (c.size() == 1) {
+					mRemoved[*it] = true;
+					if (!addUnit(c[0])) return false;
+				}
+				else {
+					mSignatures[*it] = clauseSignature(c.data(), c.size());
+					mSubsumeQueue.push_back(*it);
+				}
+			}
+			falsified.clear();
+		}
+		return true;
+	}
+
+	void pushRemoved(const Clause &c, const Lit pivot) {
+		mStack.push_back(pivot);
+		for (auto it = c.begin(); it != c.end(); it++) {
+			if (*it != pivot) mStack.push_back(*it);
+		}
+		mStack.push_back((Lit)c.size());
+	}
+
+	// The literal the binary clause ci implies from lit, which it must hold
+	// negated
+	Lit implied(const uint32_t ci, const Lit lit) const {
+		const Clause &c = mClauses[ci];
+		return c[0] == litNot(lit) ? c[1] : c[0];
+	}
+
+	// Equivalent literal substitution.  Literals on a cycle of binary
+	// clauses imply each other, so Tarjan's algorithm (iterative, to spare
+	// the stack) finds the strongly connected components of the implication
+	// graph, and every variable in one is replaced by the component's lowest.
+	// The two binary clauses that tie a replaced variable to its
+	// representative go on the elimination stack, which is how it gets its
+	// value back.  Returns false if x and ~x are in one component.
+	bool substituteEquivalences() {
+		const size_t nLits = (size_t)mnVars * 2;
+		std::vector<uint32_t> order(nLits, 0);	// Visit number, 0 for not yet
+		std::vector<uint32_t> low(nLits, 0);
+		std::vector<char> onStack(nLits, false);
+		std::vector<char> done(nLits, false);	// In a component, or its negation is
+		std::vector<Lit> repr(nLits);
+		for (size_t lit = 0; lit < nLits; lit++) {
+			repr[lit] = (Lit)lit;
+		}
+
+		std::vector<Lit> stack;
+		std::vector<std::pair<Lit, size_t>> frames;	// Literal, next of its successors
+		std::vector<Lit> component;
+		uint32_t nVisited = 0;
+		bool anyEquivalent = false;
+		for (Lit root = 0; root < nLits; root++) {
+			if (order[root] != 0 || mValues[litVar(root)] != LV_Unassigned || mEliminated[litVar(root)]) continue;
+			order[root] = low[root] = ++nVisited;
+			stack.push_back(root);
+			onStack[root] = true;
+			frames.push_back(std::make_pair(root, (size_t)0));
+			while (!frames.empty()) {
+				const Lit u = frames.back().first;
+				const std::vector<uint32_t> &successors = mOccurs[litNot(u)];
+				if (frames.back().second < successors.size()) {
+					const uint32_t ci = successors[frames.back().second++];
+					if (mRemoved[ci] || mClauses[ci].size() != 2) continue;
+					const Lit v = implied(ci, u);
+					if (order[v] == 0) {
+						order[v] = low[v] = ++nVisited;
+						stack.push_back(v);
+						onStack[v] = true;
+						frames.push_back(std::make_pair(v, (size_t)0));
+					}
+					else if (onStack[v]) {
+						low[u] = std::min(low[u], order[v]);
+					}
+					continue;
+				}
+
+				frames.pop_back();
+				if (!frames.empty()) {
+					const Lit parent = frames.back().first;
+					low[parent] = std::min(low[parent], low[u]);
+				}
+				if (low[u] != order[u]) continue;
+
+				component.clear();
+				Lit lit;
+				do {
+					lit = stack.back();
+					stack.pop_back();
+					onStack[lit] = false;
+					component.push_back(lit);
+				} while (lit != u);
+				if (component.size() == 1 || done[u]) continue;
+
+				// x and ~x in one component is a contradiction, and then this
+				// is the only component with either
+				for (auto it = component.begin(); it != component.end(); it++) {
+					done[*it] = true;
+				}
+				for (auto it = component.begin(); it != component.end(); it++) {
+					if (done[litNot(*it)]) return false;
+				}
+
+				const Lit rep = *std::min_element(component.begin(), component.end());
+				for (auto it = component.begin(); it != component.end(); it++) {
+					done[litNot(*it)] = true;
+					repr[*it] = rep;
+					repr[litNot(*it)] = litNot(rep);
+				}
+				anyEquivalent = true;
+			}
+		}
+		if (!anyEquivalent) return true;
+
+		Clause c;
+		for (int var = 0; var < mnVars; var++) {
+			const Lit pos = mkLit(var, false);
+			if (repr[pos] == pos) continue;
+
+			for (int sign = 0; sign < 2; sign++) {
+				std::vector<uint32_t> &occurs = mOccurs[sign == 0 ? pos : litNot(pos)];
+				for (size_t i = 0; i < occurs.size(); i++) {
+					const uint32_t ci = occurs[i];
+					if (mRemoved[ci]) continue;
+					mRemoved[ci] = true;
+					c.clear();
+					for (auto it = mClauses[ci].begin(); it != mClauses[ci].end(); it++) {
+						c.push_back(repr[*it]);
+					}
+					std::sort(c.begin(), c.end());
+					c.erase(std::unique(c.begin(), c.end()), c.end());
+					bool tautology = false;
+					for (size_t k = 1; k < c.size(); k++) {
+						if (c[k] == litNot(c[k - 1])) tautology = true;
+					}
+					if (tautology) continue;
+					if (c.size() == 1) {
+						if (!addUnit(c[0])) return false;
+					}
+					else {
+						addClause(c);
+					}
+				}
+				occurs.clear();
+			}
+
+			const Lit rep = repr[pos];
+			pushRemoved({ pos, litNot(rep) }, pos);
+			pushRemoved({ litNot(pos), rep }, litNot(pos));
+			mEliminated[var] = true;
+			gnEquivalentVars++;
+		}
+		return propagate();
+	}
+
+	void compactOccurs(const Lit lit) {
+		std::vector<uint32_t> &occurs = mOccurs[lit];
+		size_t n = 0;
+		for (auto it = occurs.begin(); it != occurs.end(); it++) {
+			if (!mRemoved[*it]) occurs[n++] = *it;
+		}
+		occurs.resize(n);
+	}
+
+	// Removes the clauses each queued one subsumes, and strengthens those it
+	// can.  Returns false if the formula turned out unsatisfiable.
+	bool subsume() {
+		const VectorClauses clauses(mClauses, mRemoved);
+		long nSteps = 0;
+		std::vector<uint32_t> subsumed;
+		std::vector<std::pair<uint32_t, Lit>> strengthened;
+		while (!mSubsumeQueue.empty() && nSteps < SUBSUME_STEPS) {
+			const uint32_t ci = mSubsumeQueue.back();
+			mSubsumeQueue.pop_back();
+			if (mRemoved[ci]) continue;
+			const Clause &c = mClauses[ci];
+			for (auto it = c.begin(); it != c.end(); it++) {
+				compactOccurs(*it);
+				compactOccurs(litNot(*it));
+			}
+
+			nSteps += findSubsumed(clauses, mOccurs, mSignatures, mMarks, ci, subsumed, strengthened);
+			for (auto it = subsumed.begin(); it != subsumed.end(); it++) {
+				mRemoved[*it] = true;
+				gnSubsumedClauses++;
+				const Clause &d = mClauses[*it];
+				for (auto jt = d.begin(); jt != d.end(); jt++) {
+					mTouched[litVar(*jt)] = true;
+				}
+			}
+			for (auto it = strengthened.begin(); it != strengthened.end(); it++) {
+				Clause &d = mClauses[it->first];
+				d.erase(std::find(d.begin(), d.end(), it->second));
+				std::vector<uint32_t> &occurs = mOccurs[it->second];
+				occurs.erase(std::find(occurs.begin(), occurs.end(), it->first));
+				mTouched[litVar(it->second)] = true;
+				gnStrengthenedLits++;
+				if (d.size() == 1) {
+					mRemoved[it->first] = true;
+					if (!addUnit(d[0])) return false;
+				}
+				else {
+					mSignatures[it->first] = clauseSignature(d.data(), d.size());
+					mSubsumeQueue.push_back(it->first);
+				}
+			}
+			if (!propagate()) return false;
+		}
+		mSubsumeQueue.clear();
+		return true;
+	}
+
+	int newVar() {
+		mOccurs.resize(mOccurs.size() + 2);
+		mValues.push_back(LV_Unassigned);
+		mEliminated.push_back(false);
+		mMarks.resize(mMarks.size() + 2, false);
+		mTouched.push_back(false);
+		mCounts.resize(mCounts.size() + 2, 0);
+		return mnVars++;
+	}
+
+	// Lex-leader clauses for each generator of the remaining clauses'
+	// symmetries, with a fresh variable for "equal so far" at each step.
+	// Before bounded variable addition, which would give symmetric groups
+	// of clauses different shapes.  False if that shows unsatisfiability.
+	bool breakSymmetries() {
+		if ((long)std::count(mRemoved.begin(), mRemoved.end(), false) > SYMMETRY_MAX_VERTICES) return true;
+		Clauses live;
+		for (size_t i = 0; i < mClauses.size(); i++) {
+			if (!mRemoved[i]) live.push_back(mClauses[i]);
+		}
+		std::vector<std::vector<Lit>> generators;
+		SymmetryFinder(mnVars, live).findGenerators(generators);
+		gnSymmetries += (long)generators.size();
+
+		const int nFormulaVars = mnVars;
+		Clause c;
+		for (auto it = generators.begin(); it != generators.end(); it++) {
+			const std::vector<Lit> &perm = *it;
+			Lit equal = NO_LIT;	// NO_LIT before the first variable, where it always holds
+			int nVarsCovered = 0;
+			for (int var = 0; var < nFormulaVars; var++) {
+				const Lit x = mkLit(var, false);
+				const Lit y = perm[x];
+				if (y == x) continue;
+				nVarsCovered++;
+
+				// While equal so far, x <= y, so x is false if y is ~x
+				if (y == litNot(x)) {
+					if (equal == NO_LIT) {
+						if (!addUnit(litNot(x))) return false;
+					}
+					else {
+						c = { litNot(x), litNot(equal) };
+						addSortedClause(c);
+					}
+					break;
+				}
+				c = { litNot(x), y };
+				if (equal != NO_LIT) c.push_back(litNot(equal));
+				addSortedClause(c);
+				if (nVarsCovered == SYMMETRY_LEX_VARS) break;
+
+				// Still equal if x is true, so y is, or y is false, so x is
+				const Lit next = mkLit(newVar(), false);
+				c = { litNot(x), next };
+				if (equal != NO_LIT) c.push_back(litNot(equal));
+				addSortedClause(c);
+				c = { y, next };
+				if (equal != NO_LIT) c.push_back(litNot(equal));
+				addSortedClause(c);
+				equal = next;
+			}
+		}
+		return propagate();
+	}
+
+	void addSortedClause(Clause &c) {
+		std::sort(c.begin(), c.end());
+		addClause(c);
+	}
+
+	// Bounded variable addition on lit's clauses.  The matched literals
+	// start as just lit and the matched clauses as all of lit's; each step
+	// adds the literal l for which the most matched clauses (lit | R) have a
+	// partner (l | R), and keeps only those, while that makes the saving
+	// larger.  Returns whether it replaced anything.
+	bool addVariable(const Lit lit, long &nSteps) {
+		compactOccurs(lit);
+		std::vector<Lit> lits(1, lit);
+		std::vector<uint32_t> clauses(mOccurs[lit]);
+		std::vector<std::vector<uint32_t>> partners(clauses.size());	// By matched clause, one per matched literal
+		for (size_t i = 0; i < clauses.size(); i++) {
+			partners[i].push_back(clauses[i]);
+		}
+
+		std::vector<Lit> counted;
+		std::vector<std::vector<std::pair<Lit, uint32_t>>> found(clauses.size());	// Partner literal and clause, by matched clause
+		for (;;) {
+			counted.clear();
+			for (size_t i = 0; i < clauses.size(); i++) {
+				const Clause &c = mClauses[clauses[i]];
+				found[i].clear();
+				if (c.size() < 2) continue;
+
+				// Partners of c hold all of it but lit, so they are all in the
+				// occurrences of its rarest other literal
+				Lit rarest = NO_LIT;
+				for (auto it = c.begin(); it != c.end(); it++) {
+					if (*it == lit) continue;
+					mMarks[*it] = true;
+					if (rarest == NO_LIT || mOccurs[*it].size() < mOccurs[rarest].size()) rarest = *it;
+				}
+				const std::vector<uint32_t> &occurs = mOccurs[rarest];
+				for (auto it = occurs.begin(); it != occurs.end(); it++) {
+					const Clause &d = mClauses[*it];
+					if (mRemoved[*it] || d.size() != c.size()) continue;
+					nSteps += (long)d.size();
+					Lit other = NO_LIT;
+					size_t nOther = 0;
+					for (auto jt = d.begin(); jt != d.end(); jt++) {
+						if (!mMarks[*jt]) {
+							other = *jt;
+							nOther++;
+						}
+					}
+					if (nOther != 1 || std::find(lits.begin(), lits.end(), other) != lits.end()) continue;
+					found[i].push_back(std::make_pair(other, *it));
+					if (mCounts[other]++ == 0) counted.push_back(other);
+				}
+				for (auto it = c.begin(); it != c.end(); it++) {
+					mMarks[*it] = false;
+				}
+			}
+
+			Lit best = NO_LIT;
+			for (auto it = counted.begin(); it != counted.end(); it++) {
+				if (best == NO_LIT || mCounts[*it] > mCounts[best]) best = *it;
+			}
+			const long nLits = (long)lits.size();
+			const long saving = nLits * (long)clauses.size() - nLits - (long)clauses.size();
+			const long bestSaving = best == NO_LIT ? 0 : (nLits + 1) * (long)mCounts[best] - (nLits + 1) - (long)mCounts[best];
+			for (auto it = counted.begin(); it != counted.end(); it++) {
+				mCounts[*it] = 0;
+			}
+			if (best == NO_LIT || bestSaving <= saving || nSteps >= ADD_STEPS) break;
+
+			// Keep the matched clauses best has partners for, with their partners
+			size_t n = 0;
+			for (size_t i = 0; i < clauses.size(); i++) {
+				for (auto it = found[i].begin(); it != found[i].end(); it++) {
+					if (it->first != best) continue;
+					clauses[n] = clauses[i];
+					partners[n].swap(partners[i]);
+					partners[n].push_back(it->second);
+					n++;
+					break;
+				}
+			}
+			clauses.resize(n);
+			partners.resize(n);
+			lits.push_back(best);
+		}
+
+		const long nLits = (long)lits.size();
+		if (nLits < 2 || nLits * (long)clauses.size() - nLits - (long)clauses.size() <= 0) return false;
+
+		const Lit x = mkLit(newVar(), false);
+		std::vector<Clause> added;
+		for (auto it = lits.begin(); it != lits.end(); it++) {
+			added.push_back({ *it, x });
+		}
+		for (size_t i = 0; i < clauses.size(); i++) {
+			Clause rest;
+			const Clause &c = mClauses[clauses[i]];
+			rest.push_back(litNot(x));
+			for (auto it = c.begin(); it != c.end(); it++) {
+				if (*it != lit) rest.push_back(*it);
+			}
+			added.push_back(rest);
+			for (auto it = partners[i].begin(); it != partners[i].end(); it++) {
+				mRemoved[*it] = true;
+			}
+		}
+		for (auto it = added.begin(); it != added.end(); it++) {
+			std::sort(it->begin(), it->end());
+			addClause(*it);
+		}
+		gnAddedVars++;
+		return true;
+	}
+
+	// Rounds of bounded variable addition over the literals, the most
+	// frequent first, until one adds nothing
+	void addVariables() {
+		long nSteps = 0;
+		std::vector<std::pair<size_t, Lit>> candidates;
+		bool added = true;
+		while (added && nSteps < ADD_STEPS) {
+			added = false;
+			candidates.clear();
+			for (Lit lit = 0; lit < (Lit)mnVars * 2; lit++) {
+				if (mValues[litVar(lit)] != LV_Unassigned || mEliminated[litVar(lit)]) continue;
+				compactOccurs(lit);
+				if (mOccurs[lit].size() >= 3) candidates.push_back(std::make_pair(mOccurs[lit].size(), lit));
+			}
+			std::sort(candidates.rbegin(), candidates.rend());
+			for (auto it = candidates.begin(); it != candidates.end() && nSteps < ADD_STEPS; it++) {
+				if (addVariable(it->second, nSteps)) added = true;
+			}
+		}
+	}
+
+	// The resolvent of a (with pivot) and b (with ~pivot), or false if it is
+	// a tautology
+	bool resolve(const Clause &a, const Clause &b, const Lit pivot, Clause &resolvent) {
+		resolvent.clear();
+		for (auto it = a.begin(); it != a.end(); it++) {
+			if (*it == pivot) continue;
+			mMarks[*it] = true;
+			resolvent.push_back(*it);
+		}
+		bool tautology = false;
+		for (auto it = b.begin(); it != b.end() && !tautology; it++) {
+			if (*it == litNot(pivot) || mMarks[*it]) continue;
+			if (mMarks[litNot(*it)]) tautology = true;
+			else resolvent.push_back(*it);
+		}
+		for (auto it = a.begin(); it != a.end(); it++) {
+			mMarks[*it] = false;
+		}
+		mnSteps += (long)(a.size() + b.size());
+		return !tautology;
+	}
+
+	// Returns false if the formula turned out unsatisfiable
+	bool tryEliminate(const int var, bool &eliminated) {
+		eliminated = false;
+		const Lit pos = mkLit(var, false);
+		const Lit neg = mkLit(var, true);
+		compactOccurs(pos);
+		compactOccurs(neg);
+		const std::vector<uint32_t> &posOccurs = mOccurs[pos];
+		const std::vector<uint32_t> &negOccurs = mOccurs[neg];
+		if ((int)posOccurs.size() > gElimOccurrences || (int)negOccurs.size() > gElimOccurrences) return true;
+		if (posOccurs.empty() && negOccurs.empty()) return true;
+
+		const size_t limit = posOccurs.size() + negOccurs.size();
+		mResolvents.clear();
+		Clause resolvent;
+		for (auto it = posOccurs.begin(); it != posOccurs.end(); it++) {
+			for (auto jt = negOccurs.begin(); jt != negOccurs.end(); jt++) {
+				if (!resolve(mClauses[*it], mClauses[*jt], pos, resolvent)) continue;
+				if (mResolvents.size() == limit || resolvent.size() > ELIM_MAX_RESOLVENT) return true;
+				mResolvents.push_back(resolvent);
+			}
+		}
+
+		for (int sign = 0; sign < 2; sign++) {
+			const Lit pivot = sign == 0 ? pos : neg;
+			std::vector<uint32_t> &occurs = mOccurs[pivot];
+			for (auto it = occurs.begin(); it != occurs.end(); it++) {
+				const Clause &c = mClauses[*it];
+				pushRemoved(c, pivot);
+				for (auto jt = c.begin(); jt != c.end(); jt++) {
+					mTouched[litVar(*jt)] = true;
+				}
+				mRemoved[*it] = true;
+			}
+			occurs.clear();
+		}
+		mEliminated[var] = true;
+		eliminated = true;
+
+		for (auto it = mResolvents.begin(); it != mResolvents.end(); it++) {
+			if (it->empty()) return false;
+			if (it->size() == 1) {
+				if (!addUnit((*it)[0])) return false;
+			}
+			else {
+				addClause(*it);
+			}
+		}
+		return propagate();
+	}
+
+public:
+	Eliminator(const int nVars) {
+		mnVars = nVars;
+		mOccurs.resize(nVars * 2);
+		mValues.assign(nVars, LV_Unassigned);
+		mEliminated.assign(nVars, false);
+		mMarks.assign(nVars * 2, false);
+		mTouched.assign(nVars, true);
+		mCounts.assign(nVars * 2, 0);
+		mnSteps = 0;
+	}
+
+	// Simplifies clauses in place.  Returns false if they are unsatisfiable.
+	bool eliminate(Clauses &clauses) {
+		Clauses input;
+		input.swap(clauses);
+		mClauses.reserve(input.size());
+		for (auto it = input.begin(); it != input.end(); it++) {
+			Clause &c = *it;
+			std::sort(c.begin(), c.end());
+			c.erase(std::unique(c.begin(), c.end()), c.end());
+			bool tautology = false;
+			for (size_t k = 1; k < c.size(); k++) {
+				if (c[k] == litNot(c[k - 1])) tautology = true;
+			}
+			if (tautology) continue;
+			if (c.empty()) return false;
+			if (c.size() == 1) {
+				if (!addUnit(c[0])) return false;
+			}
+			else {
+				addClause(c);
+			}
+		}
+		input.clear();
+		if (!propagate() || !substituteEquivalences()) return false;
+
+		// Rounds over the variables whose clauses changed, cheapest first
+		std::vector<std::pair<size_t, int>> candidates;
+		for (;;) {
+			if (!subsume()) return false;
+			candidates.clear();
+			for (int var = 0; var < mnVars; var++) {
+				if (!mTouched[var] || mEliminated[var] || mValues[var] != LV_Unassigned) continue;
+				mTouched[var] = false;
+				candidates.push_back(std::make_pair(mOccurs[mkLit(var, false)].size() * mOccurs[mkLit(var, true)].size(), var));
+			}
+			if (candidates.empty()) break;
+			std::sort(candidates.begin(), candidates.end());
+
+			for (auto it = candidates.begin(); it != candidates.end() && mnSteps < ELIM_STEPS; it++) {
+				if (mValues[it->second] != LV_Unassigned) continue;
+				bool eliminated;
+				if (!tryEliminate(it->second, eliminated)) return false;
+				if (eliminated) gnEliminatedVars++;
+			}
+			if (mnSteps >= ELIM_STEPS) break;
+		}
+		if (!breakSymmetries()) return false;
+		addVariables();
+
+		for (size_t i = 0; i < mClauses.size(); i++) {
+			if (!mRemoved[i]) clauses.push_back(mClauses[i]);
+		}
+		for (int var = 0; var < mnVars; var++) {
+			if (mValues[var] != LV_Unassigned) clauses.push_back(Clause(1, mkLit(var, mValues[var] == LV_False)));
+		}
+		Clauses().swap(mClauses);
+		return true;
+	}
+
+	// Including the ones bounded variable addition made
+	int varCount() const { return mnVars; }
+
+	// Gives the eliminated variables values that satisfy their clauses,
+	// given a model of the simplified clauses
+	void extend(std::vector<char> &model) const {
+		size_t end = mStack.size();
+		while (end > 0) {
+			const size_t size = mStack[end - 1];
+			const size_t start = end - 1 - size;
+			bool satisfied = false;
+			for (size_t k = start; k < end - 1 && !satisfied; k++) {
+				satisfied = model[litVar(mStack[k])] != litNegated(mStack[k]);
+			}
+			if (!satisfied) model[litVar(mStack[start])] = !litNegated(mStack[start]);
+			end = start;
+		}
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Solve
+
+class SolveResult {
+public:
+	bool mSatisfied;
+	std::string mError;
+	WorkingValues mLiterals;
+
+	SolveResult() {
+		mSatisfied = false;
+		mError = "Not run yet";
+	}
+
+	void setError(const std::string &error) {
+		mError = error;
+	}
+
+	bool isError() const { return ! mError.empty(); }
+
+	void setSatisfied(const WorkingValues &literals) {
+		mSatisfied = true;
+		mError.clear();
+		mLiterals = literals;
+	}
+
+	void setUnsat() {
+		mSatisfied = false;
+		mError.clear();
+		mLiterals.clear();
+	}
+
+	bool isSatisfied() const { return mSatisfied; }
+
+	std::string toString() const {
+		if (isError()) {
+			return mError;
+		}
+
+		if (!isSatisfied()) {
+			return "Unstatisfied";
+		}
+
+		return "Satisfied with " + mLiterals.toString();
+	}
+};
+
+// A backjump further than this many levels backtracks one level instead
+// (chronological backtracking), so a long trail is not thrown away and
+// propagated all over again.  0 always backjumps.
+static int gChronoLevels = 100;
+
+static const long PROBE_PROPAGATIONS = 10 * MEGA;	// Spent on probing before the search
+
+enum { VIVIFY_PERCENT = 3 };	// Of the search's propagations, spent vivifying
+
+static void countConflict() {
+	gnConflicts++;
+
+	if ((gnConflicts % (100 * KILO)) == 0) {
+		std::cerr << "Conflicts: " << prettyNumber(gnConflicts) << std::endl;
+	}
+}
+
+// Conflict driven clause learning.  Propagation uses two watched literals
+// per clause, with the watched pair kept in the first two slots.  A conflict
+// is resolved back to its first unique implication point, the learned clause
+// is added and the search jumps back to the level where it becomes unit.
+// Which variable to decide next is up to the Brancher, when to restart is up
+// to Restarts, and which value to try is up to the phases.
+class Solver {
+	int mnVars;
+	ClauseArena mArena;
+	float mClauseInc;
+	long mNextReduce;	// Conflict count
+	int mnReductions;
+	std::vector<std::vector<ClauseRef>> mWatches;	// By watched literal
+	LitValues mValues;	// By variable
+	std::vector<int> mLevels;	// Decision level each variable was assigned at
+	std::vector<ClauseRef> mReasons;	// Clause that implied each variable, or NO_REASON
+	std::vector<Lit> mTrail;	// Assigned literals, oldest first
+	std::vector<size_t> mLevelStarts;	// Where each decision level starts on mTrail
+	size_t mnPropagated;	// mTrail[mnPropagated..] are still to propagate
+	std::unique_ptr<Brancher> mpBrancher;
+	std::vector<char> mSeen;
+	Clause mLearnt;
+	std::vector<Lit> mMinimizeStack;
+	std::vector<int> mToClear;	// Variables marked seen by minimization
+	Restarts mRestarts;
+	std::vector<uint32_t> mLevelMarks;	// For counting distinct levels, by level
+	uint32_t mLevelMark;
+	std::vector<char> mSavedPhases;	// Value each variable last had
+	std::vector<uint8_t> mTargetPhases;	// LitValue each variable had on the target trail
+	std::vector<uint8_t> mBestPhases;
+	size_t mTargetSize;	// Length of the target trail
+	size_t mBestSize;
+	long mNextRephase;	// Conflict count
+	int mnRephases;
+	long mVivifyPropagations;	// gnPropagations at the last vivification
+	Random mRandom;
+	bool mUnsat;	// An empty clause, or units that contradict
+	bool mProbed;	// Only the first solve probes
+	std::vector<Lit> mAssumptions;	// Decided first, one level each
+	const std::atomic<bool> *mpStop;	// Another thread has settled the answer
+
+	LitValue litValue(const Lit lit) const {
+		const LitValue value = mValues.get(litVar(lit));
+		if (value == LV_Unassigned) return value;
+		return (LitValue)(value ^ (lit & 1));
+	}
+
+	int level() const { return (int)mLevelStarts.size(); }
+
+	// Unsatisfiable whatever is assumed
+	bool fail() {
+		mUnsat = true;
+		return false;
+	}
+
+	void newLevel() {
+		mLevelStarts.push_back(mTrail.size());
+	}
+
+	void assign(const Lit lit, const ClauseRef reason, const int level) {
+		const int var = litVar(lit);
+		mValues.set(var, !litNegated(lit));
+		mLevels[var] = level;
+		mReasons[var] = reason;
+		mTrail.push_back(lit);
+	}
+
+	// Unassigns everything above the given decision level.  After a
+	// chronological backtrack the trail is out of order -- an implied literal
+	// gets the highest level of its reason, which can be below the level it
+	// was found at -- so lower level literals are kept, in order, and
+	// propagated again.
+	void undoToLevel(const int level) {
+		if (level >= this->level()) return;
+		const size_t start = mLevelStarts[level];
+		size_t keep = start;
+		for (size_t i = start; i < mTrail.size(); i++) {
+			const Lit lit = mTrail[i];
+			const int var = litVar(lit);
+			if (mLevels[var] <= level) {
+				mTrail[keep++] = lit;
+				continue;
+			}
+			mSavedPhases[var] = !litNegated(lit);
+			mValues.set(var, LV_Unassigned);
+			mpBrancher->unassigned(var);
+		}
+		mTrail.resize(keep);
+		mLevelStarts.resize(level);
+		mnPropagated = std::min(mnPropagated, start);
+	}
+
+	// Highest level among literals 1.. of the clause
+	int impliedLevel(const ClauseRef ref) const {
+		const Lit *c = mArena.lits(ref);
+		int level = 0;
+		for (uint32_t k = 1; k < mArena.size(ref); k++) {
+			level = std::max(level, mLevels[litVar(c[k])]);
+		}
+		return level;
+	}
+
+	void watch(const ClauseRef ref) {
+		const Lit *c = mArena.lits(ref);
+		mWatches[c[0]].push_back(ref);
+		mWatches[c[1]].push_back(ref);
+	}
+
+	// Returns the clause that became false, or NO_REASON
+	ClauseRef propagate() {
+		while (mnPropagated < mTrail.size()) {
+			const Lit falseLit = litNot(mTrail[mnPropagated++]);
+			gnPropagations++;
+
+			std::vector<ClauseRef> &watches = mWatches[falseLit];
+			size_t keep = 0;
+			for (size_t i = 0; i < watches.size(); i++) {
+				const ClauseRef ref = watches[i];
+				Lit *c = mArena.lits(ref);
+				const uint32_t n = mArena.size(ref);
+				if (c[0] == falseLit) std::swap(c[0], c[1]);
+				if (litValue(c[0]) == LV_True) {
+					watches[keep++] = ref;
+					continue;
+				}
+
+				// Move the watch to any literal that is not false
+				uint32_t k = 2;
+				while (k < n && litValue(c[k]) == LV_False) k++;
+				if (k < n) {
+					std::swap(c[1], c[k]);
+					mWatches[c[1]].push_back(ref);
+					continue;
+				}
+
+				watches[keep++] = ref;
+				if (litValue(c[0]) == LV_False) {
+					while (++i < watches.size()) watches[keep++] = watches[i];
+					watches.resize(keep);
+					return ref;
+				}
+				assign(c[0], ref, gChronoLevels > 0 ? impliedLevel(ref) : level());
+			}
+			watches.resize(keep);
+		}
+		return NO_REASON;
+	}
+
+	// One bit per decision level (mod 32), to rule out a literal whose
+	// implications reach a level the learned clause does not touch
+	uint32_t abstractLevel(const int var) const {
+		return (uint32_t)1 << (mLevels[var] & 31);
+	}
+
+	// Whether lit's reason, followed back recursively, only leads to
+	// literals already in the learned clause (seen) or fixed at level 0, in
+	// which case lit is implied by the rest and can go.  Uses an explicit
+	// stack; variables it marks seen on success are left for analyze() to clear.
+	bool isRedundant(const Lit lit, const uint32_t levels) {
+		const size_t firstToClear = mToClear.size();
+		mMinimizeStack.clear();
+		mMinimizeStack.push_back(lit);
+		while (!mMinimizeStack.empty()) {
+			const ClauseRef reason = mReasons[litVar(mMinimizeStack.back())];
+			mMinimizeStack.pop_back();
+
+			const Lit *c = mArena.lits(reason);
+			for (uint32_t k = 1; k < mArena.size(reason); k++) {
+				const int var = litVar(c[k]);
+				if (mSeen[var] || mLevels[var] == 0) continue;
+				if (mReasons[var] == NO_REASON || (abstractLevel(var) & levels) == 0) {
+					for (size_t i = firstToClear; i < mToClear.size(); i++) {
+						mSeen[mToClear[i]] = false;
+					}
+					mToClear.resize(firstToClear);
+					return false;
+				}
+				mSeen[var] = true;
+				mMinimizeStack.push_back(c[k]);
+				mToClear.push_back(var);
+			}
+		}
+		return true;
+	}
+
+	// Recursive minimization: drops every literal the others already imply
+	// through the implication graph
+	void minimizeLearnt() {
+		uint32_t levels = 0;
+		for (size_t k = 1; k < mLearnt.size(); k++) {
+			levels |= abstractLevel(litVar(mLearnt[k]));
+		}
+
+		mToClear.clear();
+		size_t keep = 1;
+		for (size_t k = 1; k < mLearnt.size(); k++) {
+			const int var = litVar(mLearnt[k]);
+			mToClear.push_back(var);
+			if (mReasons[var] == NO_REASON || !isRedundant(mLearnt[k], levels)) {
+				mLearnt[keep++] = mLearnt[k];
+			}
+		}
+		gnMinimizedLits += mLearnt.size() - keep;
+		mLearnt.resize(keep);
+
+		for (auto it = mToClear.begin(); it != mToClear.end(); it++) {
+			mSeen[*it] = false;
+		}
+	}
+
+	// First UIP.  Resolves the conflict with the reasons on the trail until
+	// one literal of the current level is left; mLearnt[0] is its negation
+	// and mLearnt[1] has the highest level of the rest.  Returns that level.
+	int analyze(ClauseRef conflict) {
+		mLearnt.clear();
+		mLearnt.push_back(NO_LIT);
+
+		int nOpen = 0;	// Seen literals of the current level not yet resolved
+		Lit lit = NO_LIT;
+		size_t index = mTrail.size();
+		do {
+			bumpClause(conflict);
+			const Lit *c = mArena.lits(conflict);
+			for (uint32_t k = lit == NO_LIT ? 0 : 1; k < mArena.size(conflict); k++) {
+				const int var = litVar(c[k]);
+				if (mSeen[var] || mLevels[var] == 0) continue;
+				mSeen[var] = true;
+				mpBrancher->bump(var);
+				if (mLevels[var] == level()) {
+					nOpen++;
+				}
+				else {
+					mLearnt.push_back(c[k]);
+				}
+			}
+
+			// Seen literals of lower levels can sit above these after a
+			// chronological backtrack; they are already in mLearnt
+			while (!mSeen[litVar(mTrail[--index])] || mLevels[litVar(mTrail[index])] != level()) {
+			}
+			lit = mTrail[index];
+			conflict = mReasons[litVar(lit)];
+			mSeen[litVar(lit)] = false;
+		} while (--nOpen > 0);
+		mLearnt[0] = litNot(lit);
+		minimizeLearnt();
+		gnLearntLits += mLearnt.size();
+
+		int backLevel = 0;
+		for (size_t k = 1; k < mLearnt.size(); k++) {
+			const int var = litVar(mLearnt[k]);
+			if (mLevels[var] > backLevel) {
+				backLevel = mLevels[var];
+				std::swap(mLearnt[1], mLearnt[k]);
+			}
+		}
+		return backLevel;
+	}
+
+	int computeLbd(const Lit *pLits, const size_t n) {
+		mLevelMark++;
+		int lbd = 0;
+		for (const Lit *it = pLits; it != pLits + n; it++) {
+			const int level = mLevels[litVar(*it)];
+			if (mLevelMarks[level] == mLevelMark) continue;
+			mLevelMarks[level] = mLevelMark;
+			lbd++;
+		}
+		return lbd;
+	}
+
+	// Trail reuse: the levels the search would decide again straight away,
+	// because their decisions still rank ahead of the best unassigned
+	// variable, are kept rather than undone and redone.  Assumption levels
+	// are always kept -- they would be decided again first anyway.
+	int reuseLevel() {
+		const int next = mpBrancher->peek(mValues);
+		if (next < 0) return level();
+		int keep = std::min(level(), (int)mAssumptions.size());
+		while (keep < level() && mpBrancher->before(litVar(mTrail[mLevelStarts[keep]]), next)) {
+			keep++;
+		}
+		return keep;
+	}
+
+	// Learned clauses in a conflict are marked used, bumped, and promoted if
+	// their LBD has dropped
+	void bumpClause(const ClauseRef ref) {
+		if (!mArena.isLearnt(ref)) return;
+
+		mArena.setUsed(ref, true);
+		const float activity = mArena.activity(ref) + mClauseInc;
+		mArena.setActivity(ref, activity);
+		if (activity > CLAUSE_ACTIVITY_LIMIT) {
+			for (ClauseRef it = mArena.begin(); it != mArena.end(); it = mArena.next(it)) {
+				if (mArena.isLearnt(it)) mArena.setActivity(it, mArena.activity(it) / CLAUSE_ACTIVITY_LIMIT);
+			}
+			mClauseInc /= CLAUSE_ACTIVITY_LIMIT;
+		}
+		if (mArena.tier(ref) != CT_Core) {
+			const int lbd = computeLbd(mArena.lits(ref), mArena.size(ref));
+			if (lbd < mArena.lbd(ref)) {
+				mArena.setLbd(ref, lbd);
+				if (tierForLbd(lbd) < mArena.tier(ref)) mArena.setTier(ref, tierForLbd(lbd));
+			}
+		}
+	}
+
+	// A clause that is the reason for an assignment cannot go
+	bool isLocked(const ClauseRef ref) const {
+		const int var = litVar(mArena.lits(ref)[0]);
+		return mReasons[var] == ref && mValues.get(var) != LV_Unassigned;
+	}
+
+	void reduceDb() {
+		mnReductions++;
+		mNextReduce = gnConflicts + REDUCE_FIRST + (long)REDUCE_INCREMENT * mnReductions;
+
+		std::vector<ClauseRef> candidates;
+		for (ClauseRef ref = mArena.begin(); ref != mArena.end(); ref = mArena.next(ref)) {
+			if (!mArena.isLearnt(ref)) continue;
+			if (mArena.tier(ref) == CT_Tier2 && !mArena.isUsed(ref)) mArena.setTier(ref, CT_Local);
+			else if (mArena.tier(ref) == CT_Local && !mArena.isUsed(ref) && !isLocked(ref)) candidates.push_back(ref);
+			mArena.setUsed(ref, false);
+		}
+
+		const ClauseArena &arena = mArena;
+		std::sort(candidates.begin(), candidates.end(), [&arena](const ClauseRef a, const ClauseRef b) {
+			return arena.activity(a) < arena.activity(b);
+		});
+		for (size_t i = 0; i < candidates.size() / 2; i++) {
+			mArena.markDeleted(candidates[i]);
+			gnDeletedClauses++;
+		}
+		collectGarbage();
+	}
+
+	// Copies the live clauses into a compact arena, then follows the old
+	// headers to move the watch lists and the reasons over
+	void collectGarbage() {
+		ClauseArena to;
+		to.reserve(mArena.words() - mArena.wasted());
+		for (ClauseRef ref = mArena.begin(); ref != mArena.end(); ref = mArena.next(ref)) {
+			if (!mArena.isDeleted(ref)) mArena.moveTo(ref, to);
+		}
+
+		for (auto it = mWatches.begin(); it != mWatches.end(); it++) {
+			size_t n = 0;
+			for (auto jt = it->begin(); jt != it->end(); jt++) {
+				if (!mArena.isDeleted(*jt)) (*it)[n++] = mArena.movedTo(*jt);
+			}
+			it->resize(n);
+		}
+		for (auto it = mTrail.begin(); it != mTrail.end(); it++) {
+			ClauseRef &reason = mReasons[litVar(*it)];
+			if (reason != NO_REASON) reason = mArena.movedTo(reason);
+		}
+		mArena.swap(to);
+	}
+
+	// Levels below the current one were conflict free, so at a conflict the
+	// trail up to the current level can be the new target or best
+	void updateTargetAndBest() {
+		const size_t size = mLevelStarts.back();
+		if (size > mTargetSize) {
+			mTargetSize = size;
+			for (size_t i = 0; i < size; i++) {
+				mTargetPhases[litVar(mTrail[i])] = litNegated(mTrail[i]) ? LV_False : LV_True;
+			}
+		}
+		if (size > mBestSize) {
+			mBestSize = size;
+			for (size_t i = 0; i < size; i++) {
+				mBestPhases[litVar(mTrail[i])] = litNegated(mTrail[i]) ? LV_False : LV_True;
+			}
+		}
+	}
+
+	// Assumes lit at level 1 and propagates.  Returns the conflict, or
+	// NO_REASON with the implications left on the trail.
+	ClauseRef probeLit(const Lit lit) {
+		newLevel();
+		assign(lit, NO_REASON, 1);
+		return propagate();
+	}
+
+	// Fixes lit at level 0.  Returns false on a conflict.
+	bool fixLit(const Lit lit) {
+		undoToLevel(0);
+		if (litValue(lit) == LV_False) return false;
+		if (litValue(lit) == LV_Unassigned) assign(lit, NO_REASON, 0);
+		return propagate() == NO_REASON;
+	}
+
+	// Failed literal probing, at level 0 before the search.  Each variable
+	// is assumed both ways: a literal whose propagation conflicts has failed,
+	// so its negation holds, and a literal both ways imply holds too.  The
+	// saved phases are put back afterwards, so the probes do not steer the
+	// search.  Returns false if the formula is unsatisfiable.
+	bool probe() {
+		if (propagate() != NO_REASON) return false;
+		const std::vector<char> savedPhases(mSavedPhases);
+		std::vector<char> marks(mnVars * 2, false);
+		std::vector<Lit> implied;
+		std::vector<Lit> necessary;
+		const long lastPropagation = gnPropagations + PROBE_PROPAGATIONS;
+		for (int var = 0; var < mnVars && gnPropagations < lastPropagation; var++) {
+			if (mValues.get(var) != LV_Unassigned) continue;
+
+			const Lit pos = mkLit(var, false);
+			if (probeLit(pos) != NO_REASON) {
+				gnFailedLits++;
+				if (!fixLit(litNot(pos))) return false;
+				continue;
+			}
+			implied.assign(mTrail.begin() + mLevelStarts[0] + 1, mTrail.end());
+			for (auto it = implied.begin(); it != implied.end(); it++) {
+				marks[*it] = true;
+			}
+			undoToLevel(0);
+
+			necessary.clear();
+			if (probeLit(litNot(pos)) != NO_REASON) {
+				necessary.push_back(pos);
+				gnFailedLits++;
+			}
+			else {
+				for (size_t i = mLevelStarts[0] + 1; i < mTrail.size(); i++) {
+					if (marks[mTrail[i]]) necessary.push_back(mTrail[i]);
+				}
+				gnNecessaryLits += necessary.size();
+			}
+			undoToLevel(0);
+			for (auto it = implied.begin(); it != implied.end(); it++) {
+				marks[*it] = false;
+			}
+
+			for (auto it = necessary.begin(); it != necessary.end(); it++) {
+				if (!fixLit(*it)) return false;
+			}
+		}
+		mSavedPhases = savedPhases;
+		return true;
+	}
+
+	// Adds c as a new clause in place of ref, which goes
+	ClauseRef replaceClause(const ClauseRef ref, const Clause &c) {
+		const ClauseRef replaced = mArena.add(c.data(), (uint32_t)c.size(), mArena.tier(ref), mArena.lbd(ref));
+		mArena.setActivity(replaced, mArena.activity(ref));
+		mArena.setUsed(replaced, mArena.isUsed(ref));
+		mArena.markDeleted(ref);
+		return replaced;
+	}
+
+	// Inprocessing, at level 0: drops the clauses level 0 satisfies and the
+	// literals it falsifies, then subsumes and strengthens, then rebuilds the
+	// watches and propagates the whole trail again.  A learned clause that
+	// subsumes an original one takes its place as an original.  Returns false
+	// if the formula is unsatisfiable.
+	bool simplify() {
+		if (propagate() != NO_REASON) return false;
+		for (auto it = mTrail.begin(); it != mTrail.end(); it++) {
+			mReasons[litVar(*it)] = NO_REASON;
+		}
+
+		std::vector<ClauseRef> refs;
+		Clause c;
+		for (ClauseRef ref = mArena.begin(); ref != mArena.end(); ref = mArena.next(ref)) {
+			if (mArena.isDeleted(ref)) continue;
+			c.clear();
+			bool satisfied = false;
+			const Lit *lits = mArena.lits(ref);
+			for (uint32_t k = 0; k < mArena.size(ref) && !satisfied; k++) {
+				const LitValue value = litValue(lits[k]);
+				if (value == LV_True) satisfied = true;
+				if (value == LV_Unassigned) c.push_back(lits[k]);
+			}
+			if (satisfied) {
+				mArena.markDeleted(ref);
+			}
+			else if (c.size() < mArena.size(ref)) {
+				// Clauses are always propagated, so at least two are left
+				replaceClause(ref, c);
+			}
+			else {
+				refs.push_back(ref);
+			}
+		}
+
+		// Shortest first, so the likely subsumers go before their victims
+		const ClauseArena &arena = mArena;
+		std::sort(refs.begin(), refs.end(), [&arena](const ClauseRef a, const ClauseRef b) {
+			return arena.size(a) < arena.size(b);
+		});
+		std::vector<uint64_t> signatures(refs.size());
+		std::vector<std::vector<uint32_t>> occurs(mnVars * 2);
+		for (uint32_t i = 0; i < refs.size(); i++) {
+			const Lit *lits = mArena.lits(refs[i]);
+			signatures[i] = clauseSignature(lits, mArena.size(refs[i]));
+			for (uint32_t k = 0; k < mArena.size(refs[i]); k++) {
+				occurs[lits[k]].push_back(i);
+			}
+		}
+
+		const ArenaClauses clauses(mArena, refs);
+		std::vector<char> marks(mnVars * 2, false);
+		std::vector<uint32_t> subsumed;
+		std::vector<std::pair<uint32_t, Lit>> strengthened;
+		long nSteps = 0;
+		for (uint32_t i = 0; i < refs.size() && nSteps < SUBSUME_STEPS; i++) {
+			if (mArena.isDeleted(refs[i])) continue;
+			nSteps += findSubsumed(clauses, occurs, signatures, marks, i, subsumed, strengthened);
+			for (auto it = subsumed.begin(); it != subsumed.end(); it++) {
+				if (mArena.isLearnt(refs[i]) && !mArena.isLearnt(refs[*it])) mArena.setTier(refs[i], CT_Original);
+				mArena.markDeleted(refs[*it]);
+				gnSubsumedClauses++;
+			}
+
+			// The strengthened clause stays at its index, so a stale
+			// occurrence of the lost literal only costs a comparison
+			for (auto it = strengthened.begin(); it != strengthened.end(); it++) {
+				const ClauseRef ref = refs[it->first];
+				const Lit *dLits = mArena.lits(ref);
+				c.assign(dLits, dLits + mArena.size(ref));
+				c.erase(std::find(c.begin(), c.end(), it->second));
+				gnStrengthenedLits++;
+				if (c.size() == 1) {
+					mArena.markDeleted(ref);
+					const LitValue value = litValue(c[0]);
+					if (value == LV_False) return false;
+					if (value == LV_Unassigned) assign(c[0], NO_REASON, 0);
+					continue;
+				}
+				refs[it->first] = replaceClause(ref, c);
+				signatures[it->first] = clauseSignature(c.data(), c.size());
+			}
+		}
+
+		collectGarbage();
+		for (auto it = mWatches.begin(); it != mWatches.end(); it++) {
+			it->clear();
+		}
+		for (ClauseRef ref = mArena.begin(); ref != mArena.end(); ref = mArena.next(ref)) {
+			watch(ref);
+		}
+		mnPropagated = 0;
+		return true;
+	}
+
+	// Vivification, at level 0: the literals of a clause are assumed false
+	// one at a time, with propagation after each.  A literal found false
+	// already can go; one found true, or a conflict, means the literals so
+	// far are enough and the rest can go.  The work is a share of the
+	// search's own propagations since the last time.  Kept learned clauses
+	// go first, then the originals, each clause once.  Returns false if the
+	// formula is unsatisfiable.
+	bool vivify() {
+		if (propagate() != NO_REASON) return false;
+		const long lastPropagation = gnPropagations + (gnPropagations - mVivifyPropagations) * VIVIFY_PERCENT / 100;
+
+		std::vector<ClauseRef> candidates;
+		for (ClauseRef ref = mArena.begin(); ref != mArena.end(); ref = mArena.next(ref)) {
+			if (mArena.isDeleted(ref) || mArena.isVivified(ref) || mArena.size(ref) < 3 || mArena.tier(ref) == CT_Local) continue;
+			candidates.push_back(ref);
+		}
+		const ClauseArena &arena = mArena;
+		std::stable_sort(candidates.begin(), candidates.end(), [&arena](const ClauseRef a, const ClauseRef b) {
+			return arena.isLearnt(a) && !arena.isLearnt(b);
+		});
+
+		const std::vector<char> savedPhases(mSavedPhases);
+		Clause c;
+		Clause kept;
+		for (auto it = candidates.begin(); it != candidates.end() && gnPropagations < lastPropagation; it++) {
+			const ClauseRef ref = *it;
+			mArena.setVivified(ref);
+			c.assign(mArena.lits(ref), mArena.lits(ref) + mArena.size(ref));
+			bool satisfied = false;
+			for (auto jt = c.begin(); jt != c.end(); jt++) {
+				if (litValue(*jt) == LV_True) satisfied = true;
+			}
+			if (satisfied) continue;
+
+			kept.clear();
+			for (auto jt = c.begin(); jt != c.end(); jt++) {
+				const LitValue value = litValue(*jt);
+				if (value == LV_False) continue;
+				kept.push_back(*jt);
+				if (value == LV_True) break;
+				newLevel();
+				assign(litNot(*jt), NO_REASON, level());
+				if (propagate() != NO_REASON) break;
+			}
+			undoToLevel(0);
+			if (kept.size() == c.size()) continue;
+
+			gnVivifiedLits += c.size() - kept.size();
+			if (kept.size() <= 1) {
+				mArena.markDeleted(ref);
+				if (kept.empty() || !fixLit(kept[0])) return false;
+			}
+			else {
+				const ClauseRef vivified = replaceClause(ref, kept);
+				mArena.setVivified(vivified);
+				watch(vivified);
+			}
+		}
+		mSavedPhases = savedPhases;
+		mVivifyPropagations = gnPropagations;
+		collectGarbage();
+		return true;
+	}
+
+	// Only at level 0, so the walk can take level 0 as fixed
+	void rephase() {
+		const Rephase kind = REPHASE_CYCLE[mnRephases % (sizeof(REPHASE_CYCLE) / sizeof(REPHASE_CYCLE[0]))];
+		mnRephases++;
+		mNextRephase = gnConflicts + (long)REPHASE_INTERVAL * (mnRephases + 1);
+
+		for (int var = 0; var < mnVars; var++) {
+			switch (kind) {
+			case RE_Original:
+				mSavedPhases[var] = ORIGINAL_PHASE;
+				break;
+			case RE_Inverted:
+				mSavedPhases[var] = !ORIGINAL_PHASE;
+				break;
+			case RE_Best:
+				if (mBestPhases[var] != LV_Unassigned) mSavedPhases[var] = mBestPhases[var] == LV_True;
+				break;
+			case RE_Random:
+				mSavedPhases[var] = (mRandom.next() >> 63) != 0;
+				break;
+			case RE_Walk:
+				break;
+			}
+		}
+		if (kind == RE_Walk) {
+			walkPhases(mArena, mValues, mSavedPhases, mRandom);
+		}
+		if (kind == RE_Best) {
+			mBestSize = 0;
+		}
+		mTargetSize = 0;
+		std::fill(mTargetPhases.begin(), mTargetPhases.end(), (uint8_t)LV_Unassigned);
+	}
+
+	bool decisionPhase(const int var) const {
+		if (mTargetPhases[var] != LV_Unassigned) return mTargetPhases[var] == LV_True;
+		return mSavedPhases[var] != 0;
+	}
+
+public:
+	// Duplicates are dropped and tautologies skipped, so a compiled file
+	// with odd gates cannot confuse the watches.  Between solves the search
+	// goes back to level 0 first, and literals fixed there are dealt with
+	// now, since a watch on one that is already false would never be
+	// visited again.
+	void addClause(Clause &c) {
+		undoToLevel(0);
+		std::sort(c.begin(), c.end());
+		c.erase(std::unique(c.begin(), c.end()), c.end());
+		for (size_t k = 1; k < c.size(); k++) {
+			if (c[k] == litNot(c[k - 1])) return;
+		}
+		size_t keep = 0;
+		for (size_t k = 0; k < c.size(); k++) {
+			const LitValue value = litValue(c[k]);
+			if (value == LV_True) return;
+			if (value == LV_Unassigned) c[keep++] = c[k];
+		}
+		c.resize(keep);
+
+		if (c.empty()) {
+			mUnsat = true;
+		}
+		else if (c.size() == 1) {
+			const LitValue value = litValue(c[0]);
+			if (value == LV_False) mUnsat = true;
+			if (value == LV_Unassigned) assign(c[0], NO_REASON, 0);
+		}
+		else {
+			watch(mArena.add(c.data(), (uint32_t)c.size(), CT_Original, 0));
+		}
+	}
+
+	// Takes the clauses apart
+	Solver(const int nVars, Clauses &clauses) : mpBrancher(newBrancher(gHeuristic, nVars)), mRestarts(gRestartPolicy), mRandom(nVars) {
+		mnVars = nVars;
+		mWatches.resize(nVars * 2);
+		mValues = LitValues(nVars);
+		mLevels.assign(nVars, 0);
+		mReasons.assign(nVars, NO_REASON);
+		mTrail.reserve(nVars);
+		mnPropagated = 0;
+		mSeen.assign(nVars, false);
+		mLevelMarks.assign(nVars + 1, 0);
+		mLevelMark = 0;
+		mSavedPhases.assign(nVars, ORIGINAL_PHASE);
+		mTargetPhases.assign(nVars, LV_Unassigned);
+		mBestPhases.assign(nVars, LV_Unassigned);
+		mTargetSize = 0;
+		mBestSize = 0;
+		mnRephases = 0;
+		mNextRephase = gnConflicts + REPHASE_INTERVAL;
+		mVivifyPropagations = gnPropagations;
+		mUnsat = false;
+		mProbed = false;
+		mpStop = nullptr;
+
+		size_t words = 0;
+		std::vector<char> used(nVars, false);
+		for (auto it = clauses.begin(); it != clauses.end(); it++) {
+			words += ClauseArena::HEADER_WORDS + it->size();
+			for (auto jt = it->begin(); jt != it->end(); jt++) {
+				used[litVar(*jt)] = true;
+			}
+		}
+		mArena.reserve(words);
+		for (auto it = clauses.begin(); it != clauses.end() && !mUnsat; it++) {
+			addClause(*it);
+		}
+		clauses.clear();
+
+		// Variables in no clause, eliminated ones say, are settled now
+		// rather than decided over and over
+		for (int var = 0; var < nVars; var++) {
+			if (!used[var]) assign(mkLit(var, !ORIGINAL_PHASE), NO_REASON, 0);
+		}
+		mClauseInc = 1;
+		mNextReduce = gnConflicts + REDUCE_FIRST;
+		mnReductions = 0;
+	}
+
+	// For clauses added one at a time.  Every per-variable array grows by one.
+	int newVar() {
+		const int var = mnVars++;
+		mWatches.resize(mnVars * 2);
+		mValues.grow(mnVars);
+		mLevels.push_back(0);
+		mReasons.push_back(NO_REASON);
+		mSeen.push_back(false);
+		mLevelMarks.push_back(0);
+		mSavedPhases.push_back(ORIGINAL_PHASE);
+		mTargetPhases.push_back(LV_Unassigned);
+		mBestPhases.push_back(LV_Unassigned);
+		mpBrancher->addVar();
+		return var;
+	}
+
+	// Assumptions are decided before anything else, in order, each on a
+	// level of its own (an empty one if it is already true).  false means
+	// unsatisfiable under the assumptions, and for good if they are not to
+	// blame.  Clauses and learned clauses carry over to the next call.
+	bool solve(const std::vector<Lit> &assumptions) {
+		undoToLevel(0);
+		if (mUnsat) return false;
+		if (!mProbed) {
+			mProbed = true;
+			if (!probe()) return fail();
+		}
+		mAssumptions = assumptions;
+		if (mLevelMarks.size() < mnVars + mAssumptions.size() + 1) {
+			mLevelMarks.resize(mnVars + mAssumptions.size() + 1, 0);
+		}
+
+		for (;;) {
+			const size_t first = mnPropagated;
+			const ClauseRef conflict = propagate();
+			mpBrancher->assigned(mTrail, first, conflict != NO_REASON);
+			if (conflict != NO_REASON) {
+				countConflict();
+				if (mpStop != nullptr && mpStop->load(std::memory_order_relaxed)) return false;
+
+				// The conflict can be below the current level after a
+				// chronological backtrack, so the analysis starts there
+				const int conflictLevel = impliedLevel(conflict);
+				const int firstLevel = std::max(conflictLevel, mLevels[litVar(mArena.lits(conflict)[0])]);
+				if (firstLevel == 0) return fail();
+				undoToLevel(firstLevel);
+
+				updateTargetAndBest();
+				const int backLevel = analyze(conflict);
+				const int lbd = computeLbd(mLearnt.data(), mLearnt.size());
+				mRestarts.conflict(lbd);
+				if (gChronoLevels > 0 && level() - backLevel > gChronoLevels) {
+					gnChronoBacktracks++;
+					undoToLevel(level() - 1);
+				}
+				else {
+					undoToLevel(backLevel);
+				}
+				if (mLearnt.size() == 1) {
+					assign(mLearnt[0], NO_REASON, 0);
+				}
+				else {
+					const ClauseRef ref = mArena.add(mLearnt.data(), (uint32_t)mLearnt.size(), tierForLbd(lbd), lbd);
+					watch(ref);
+					assign(mLearnt[0], ref, backLevel);
+				}
+				mClauseInc /= CLAUSE_DECAY;
+				mpBrancher->conflictDone(mValues);
+			}
+			else {
+				if (gnConflicts >= mNextReduce) {
+					reduceDb();
+				}
+				if (gnConflicts >= mNextRephase) {
+					undoToLevel(0);
+					if (!simplify() || !vivify()) return fail();
+					rephase();
+					continue;
+				}
+				if (mRestarts.due()) {
+					gnRestarts++;
+					undoToLevel(reuseLevel());
+					mRestarts.restarted();
+				}
+
+				Lit decision = NO_LIT;
+				while (decision == NO_LIT && level() < (int)mAssumptions.size()) {
+					const Lit assumption = mAssumptions[level()];
+					const LitValue value = litValue(assumption);
+					if (value == LV_False) return false;
+					if (value == LV_True) newLevel();
+					else decision = assumption;
+				}
+				if (decision == NO_LIT) {
+					const int var = mpBrancher->pick(mValues);
+					if (var < 0) return true;
+					decision = mkLit(var, !decisionPhase(var));
+				}
+
+				gnDecisions++;
+				newLevel();
+				assign(decision, NO_REASON, level());
+			}
+		}
+	}
+
+	bool solve() {
+		return solve(std::vector<Lit>());
+	}
+
+	// solve() gives up, returning false, once stop is set
+	void stopWhen(const std::atomic<bool> &stop) { mpStop = &stop; }
+
+	bool isTrue(const int var) const { return mValues.isTrue(var); }
+};
+
+//-----------------------------------------------------------------------------
+// 2-SAT
+// When no clause has more than two literals there is no need to search.
+// Each clause (a | b) is two implications, ~a -> b and ~b -> a, and the
+// clauses are unsatisfiable exactly when some x and ~x imply each other,
+// that is when they are in one strongly connected component of the
+// implication graph.  Tarjan's algorithm (iterative, to spare the stack)
+// finishes a component only after every component it reaches, so making
+// true whichever of x and ~x finished first never lets a true literal imply
+// a false one.  The whole thing is linear in the clauses.
+
+static bool isTwoSat(const Clauses &clauses) {
+	for (auto it = clauses.begin(); it != clauses.end(); it++) {
+		if (it->size() > 2) return false;
+	}
+	return true;
+}
+
+// Returns false if unsatisfiable, otherwise fills model by variable
+static bool solveTwoSat(const int nVars, const Clauses &clauses, std::vector<char> &model) {
+	const Lit nLits = (Lit)nVars * 2;
+
+	// Successors of lit are successors[starts[lit]..starts[lit + 1]], and
+	// a unit a is ~a -> a
+	std::vector<uint32_t> starts(nLits + 1, 0);
+	for (auto it = clauses.begin(); it != clauses.end(); it++) {
+		if (it->empty()) return false;
+		for (auto jt = it->begin(); jt != it->end(); jt++) {
+			starts[litNot(*jt) + 1]++;
+		}
+	}
+	for (Lit lit = 0; lit < nLits; lit++) {
+		starts[lit + 1] += starts[lit];
+	}
+	std::vector<Lit> successors(starts[nLits]);
+	std::vector<uint32_t> ends(starts.begin(), starts.end() - 1);
+	for (auto it = clauses.begin(); it != clauses.end(); it++) {
+		const Lit a = it->front();
+		const Lit b = it->back();
+		successors[ends[litNot(a)]++] = b;
+		if (it->size() == 2) successors[ends[litNot(b)]++] = a;
+	}
+
+	std::vector<uint32_t> order(nLits, 0);	// Visit number, 0 for not yet
+	std::vector<uint32_t> low(nLits, 0);
+	std::vector<uint32_t> components(nLits, 0);	// Numbered from 1 as they finish
+	std::vector<Lit> stack;	// Visited literals with no component yet
+	std::vector<std::pair<Lit, uint32_t>> frames;	// Literal, next of its successors
+	uint32_t nVisited = 0;
+	uint32_t nComponents = 0;
+	for (Lit root = 0; root < nLits; root++) {
+		if (order[root] != 0) continue;
+		order[root] = low[root] = ++nVisited;
+		stack.push_back(root);
+		frames.push_back(std::make_pair(root, starts[root]));
+		while (!frames.empty()) {
+			const Lit u = frames.back().first;
+			if (frames.back().second < starts[u + 1]) {
+				const Lit v = successors[frames.back().second++];
+				if (order[v] == 0) {
+					order[v] = low[v] = ++nVisited;
+					stack.push_back(v);
+					frames.push_back(std::make_pair(v, starts[v]));
+				}
+				else if (components[v] == 0) {
+					low[u] = std::min(low[u], order[v]);
+				}
+				continue;
+			}
+
+			frames.pop_back();
+			if (!frames.empty()) {
+				const Lit parent = frames.back().first;
+				low[parent] = std::min(low[parent], low[u]);
+			}
+			if (low[u] != order[u]) continue;
+
+			nComponents++;
+			Lit lit;
+			do {
+				lit = stack.back();
+				stack.pop_back();
+				components[lit] = nComponents;
+			} while (lit != u);
+		}
+	}
+
+	model.resize(nVars);
+	for (int var = 0; var < nVars; var++) {
+		const uint32_t pos = components[mkLit(var, false)];
+		const uint32_t neg = components[mkLit(var, true)];
+		if (pos == neg) return false;
+		model[var] = pos < neg;
+	}
+	return true;
+}
+
+// Reads the clauses straight off the graph when root is an AND of literals
+// and ORs of two literals, which is what a 2-SAT formula looks like before
+// Tseitin encoding gives every gate a variable and three clauses.  An OR is
+// a complemented AND, so each conjunct is a literal, an AND to split further,
+// or the complement of an AND of two literals.  Returns false, with clauses
+// in no particular state, for anything else.
+static bool twoSatClauses(const ExprView &nodes, const ExprRef root, Clauses &clauses) {
+	clauses.clear();
+	std::vector<char> visited(exprNode(root) + 1, 0);
+	std::vector<ExprRef> conjuncts(1, root);
+	while (!conjuncts.empty()) {
+		const ExprRef ref = conjuncts.back();
+		conjuncts.pop_back();
+		if (ref == EXPR_TRUE) continue;
+		if (ref == EXPR_FALSE) {
+			clauses.push_back(Clause());
+			continue;
+		}
+
+		const ExprNode &node = nodes[exprNode(ref)];
+		if (node.mOp == EO_Var) {
+			clauses.push_back(Clause(1, mkLit((int)node.mA, exprIsNegated(ref))));
+			continue;
+		}
+		if (node.mOp != EO_And) return false;
+		if (!exprIsNegated(ref)) {
+			if (visited[exprNode(ref)]) continue;
+			visited[exprNode(ref)] = 1;
+			conjuncts.push_back(node.mA);
+			conjuncts.push_back(node.mB);
+			continue;
+		}
+
+		const ExprNode &a = nodes[exprNode(node.mA)];
+		const ExprNode &b = nodes[exprNode(node.mB)];
+		if (a.mOp != EO_Var || b.mOp != EO_Var) return false;
+		clauses.push_back({ mkLit((int)a.mA, !exprIsNegated(node.mA)), mkLit((int)b.mA, !exprIsNegated(node.mB)) });
+	}
+	return true;
+}
+
+// Returns false if unsatisfiable, otherwise fills model by variable.  The
+// search gives up, returning false, once *pStop is set.
+static bool solveClauses(const int nVars, Clauses &clauses, const std::atomic<bool> *pStop, std::vector<char> &model) {
+	if (isTwoSat(clauses)) {
+		gnTwoSatSolves++;
+		return solveTwoSat(nVars, clauses, model);
+	}
+
+	Solver solver(nVars, clauses);
+	if (pStop != nullptr) solver.stopWhen(*pStop);
+	if (!solver.solve()) return false;
+
+	model.resize(nVars);
+	for (int var = 0; var < nVars; var++) {
+		model[var] = solver.isTrue(var);
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Components
+// Clauses that share no variable, not even through other clauses, are
+// separate problems: the formula is satisfiable when every one of them is,
+// and their models sit side by side.  Each gets its own Solver over its
+// variables numbered from 0, so a conflict in one never throws away
+// decisions made in another, and restarts, activities and learned clauses
+// stay local.  With -j the components are shared out between that many
+// threads, largest first so a big one does not start last.  On one thread
+// they go smallest first, so a cheap contradiction is found before the
+// expensive search.
+
+static int gThreads = 1;
+
+class Component {
+public:
+	std::vector<int> mVars;	// Formula variable of each component variable
+	Clauses mClauses;	// Over component variables
+	bool mSatisfied;
+	std::vector<char> mModel;	// By component variable
+
+	Component() {
+		mSatisfied = false;
+	}
+};
+
+static int findComponent(std::vector<int> &parents, int var) {
+	while (parents[var] != var) {
+		parents[var] = parents[parents[var]];
+		var = parents[var];
+	}
+	return var;
+}
+
+// With more than one component the clauses are moved into them, smallest
+// first, and units on variables in no other clause go straight into model
+// rather than each making a component of its own.  Variables in no clause
+// belong to none.  Returns the number of components, or -1 for an empty
+// clause.
+static int splitComponents(const int nVars, Clauses &clauses, std::vector<Component> &components, std::vector<char> &model) {
+	std::vector<int> occurrences(nVars, 0);
+	for (auto it = clauses.begin(); it != clauses.end(); it++) {
+		if (it->empty()) return -1;
+		for (auto jt = it->begin(); jt != it->end(); jt++) {
+			occurrences[litVar(*jt)]++;
+		}
+	}
+	auto isLoneUnit = [&occurrences](const Clause &c) { return c.size() == 1 && occurrences[litVar(c[0])] == 1; };
+
+	std::vector<int> parents(nVars);
+	for (int var = 0; var < nVars; var++) {
+		parents[var] = var;
+	}
+	for (auto it = clauses.begin(); it != clauses.end(); it++) {
+		const int root = findComponent(parents, litVar(it->front()));
+		for (auto jt = it->begin() + 1; jt != it->end(); jt++) {
+			parents[findComponent(parents, litVar(*jt))] = root;
+		}
+	}
+
+	std::vector<int> index(nVars, -1);	// By root
+	int nComponents = 0;
+	for (auto it = clauses.begin(); it != clauses.end(); it++) {
+		if (isLoneUnit(*it)) continue;
+		const int root = findComponent(parents, litVar(it->front()));
+		if (index[root] < 0) index[root] = nComponents++;
+	}
+	if (nComponents <= 1) return nComponents;
+
+	// Numbered in formula order, so each Solver sees its variables in the
+	// same order as one Solver over everything would
+	components.resize(nComponents);
+	std::vector<int> local(nVars, -1);	// Component variable
+	for (int var = 0; var < nVars; var++) {
+		const int component = index[findComponent(parents, var)];
+		if (occurrences[var] == 0 || component < 0) continue;
+		local[var] = (int)components[component].mVars.size();
+		components[component].mVars.push_back(var);
+	}
+	for (auto it = clauses.begin(); it != clauses.end(); it++) {
+		if (isLoneUnit(*it)) {
+			model[litVar(it->front())] = !litNegated(it->front());
+			continue;
+		}
+		Component &component = components[index[findComponent(parents, litVar(it->front()))]];
+		for (auto jt = it->begin(); jt != it->end(); jt++) {
+			*jt = mkLit(local[litVar(*jt)], litNegated(*jt));
+		}
+		component.mClauses.push_back(std::move(*it));
+	}
+	clauses.clear();
+
+	std::stable_sort(components.begin(), components.end(), [](const Component &a, const Component &b) {
+		return a.mClauses.size() < b.mClauses.size();
+	});
+	return nComponents;
+}
+
+static void solveComponent(Component &component, const std::atomic<bool> &stop) {
+	component.mSatisfied = solveClauses((int)component.mVars.size(), component.mClauses, &stop, component.mModel);
+}
+
+// Returns false as soon as one component is unsatisfiable
+static bool solveComponents(std::vector<Component> &components) {
+	std::atomic<bool> unsat(false);
+	const int nThreads = std::min(gThreads, (int)components.size());
+	if (nThreads <= 1) {
+		for (auto it = components.begin(); it != components.end(); it++) {
+			solveComponent(*it, unsat);
+			if (!it->mSatisfied) return false;
+		}
+		return true;
+	}
+
+	// Each worker takes the largest component left
+	std::atomic<int> next((int)components.size());
+	std::vector<std::vector<long>> counts(nThreads);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < nThreads; t++) {
+		workers.push_back(std::thread([&components, &next, &unsat, &counts, t]() {
+			for (int i = --next; i >= 0 && !unsat; i = --next) {
+				solveComponent(components[i], unsat);
+				if (!components[i].mSatisfied) unsat = true;
+			}
+			const std::vector<long *> counters = threadCounters();
+			for (auto it = counters.begin(); it != counters.end(); it++) {
+				counts[t].push_back(**it);
+			}
+		}));
+	}
+
+	const std::vector<long *> counters = threadCounters();
+	for (int t = 0; t < nThreads; t++) {
+		workers[t].join();
+		for (size_t k = 0; k < counters.size(); k++) {
+			*counters[k] += counts[t][k];
+		}
+	}
+	return !unsat;
+}
+
+// Each assumption is a unit on its literal, whose variable is its index
+static void addAssumptionUnits(const std::vector<Lit> &assumptions, Clauses &clauses) {
+	for (auto it = assumptions.begin(); it != assumptions.end(); it++) {
+		clauses.push_back(Clause(1, *it));
+	}
+}
+
+static SolveResult solve(const ExprView &nodes, const ExprRef root, const std::vector<Lit> &assumptions, WorkingValues &literals) {
+	SolveResult solveResult;
+	Clauses clauses;
+	if (twoSatClauses(nodes, root, clauses)) {
+		addAssumptionUnits(assumptions, clauses);
+		std::vector<char> model;
+		gnTwoSatSolves++;
+		if (!solveTwoSat((int)literals.size(), clauses, model)) {
+			solveResult.setUnsat();
+			return solveResult;
+		}
+		for (int i = 0; i < (int)literals.size(); i++) {
+			literals.setBool(i, model[i] != 0);
+		}
+		solveResult.setSatisfied(literals);
+		return solveResult;
+	}
+
+	// Anything else is encoded, and may still come out of preprocessing as
+	// 2-SAT, which solveClauses() checks for again
+	Eliminator eliminator(encodeCnf(nodes, root, (int)literals.size(), clauses));
+	addAssumptionUnits(assumptions, clauses);
+	if (gElimOccurrences > 0 && !eliminator.eliminate(clauses)) {
+		solveResult.setUnsat();
+		return solveResult;
+	}
+	const int nVars = eliminator.varCount();
+	std::vector<char> model(nVars, ORIGINAL_PHASE);
+	std::vector<Component> components;
+	const int nComponents = splitComponents(nVars, clauses, components, model);
+	if (nComponents > 1) {
+		if (!solveComponents(components)) {
+			solveResult.setUnsat();
+			return solveResult;
+		}
+		for (auto it = components.begin(); it != components.end(); it++) {
+			for (size_t var = 0; var < it->mVars.size(); var++) {
+				model[it->mVars[var]] = it->mModel[var];
+			}
+		}
+	}
+	else if (!solveClauses(nVars, clauses, nullptr, model)) {
+		solveResult.setUnsat();
+		return solveResult;
+	}
+	eliminator.extend(model);
+	for (int i = 0; i < (int)literals.size(); i++) {
+		literals.setBool(i, model[i] != 0);
+	}
+	solveResult.setSatisfied(literals);
+	return solveResult;
+}
+
+//-----------------------------------------------------------------------------
+// Quantifiers (2QBF)
+//   <formula> = <prefix> . <expr>
+//    <prefix> = forall <name> ... exists <name> ...
+//             = exists <name> ... forall <name> ...
+// A <name> is a literal or a whole word, and literals not named in the prefix
+// are existential.  Rather than expanding the universals into 2^k copies of the
+// formula, E X A U f is decided by counterexample guided refinement between
+// two SAT oracles:
+//   candidate:    find X satisfying f(X, u) for every counterexample u so far
+//   verification: find U falsifying f(x, U) for the candidate x
+// Each counterexample adds one copy of f with U fixed to constants, which the
+// DAG's constant folding cuts down to the parts that still depend on X.
+// A U E X f is answered as ~(E U A X ~f).
+
+class QuantBlock {
+public:
+	TokType mType;
+	std::vector<std::string> mNames;
+	std::vector<int> mLits;
+
+	QuantBlock(const TokType type) {
+		mType = type;
+	}
+};
+
+typedef std::vector<QuantBlock> QuantBlocks;
+
+// TT_Forall or TT_Exists if the token is spelled like one and a name
+// follows, otherwise TT_Unknown
+static TokType quantifierName(const Tokens &tokens, const Tokens::const_iterator it) {
+	if (it == tokens.end() || !it->isLiteral() || it + 1 == tokens.end() || !(it + 1)->isLiteral()) return TT_Unknown;
+	if (it->getLiteral() == "forall") return TT_Forall;
+	if (it->getLiteral() == "exists") return TT_Exists;
+	return TT_Unknown;
+}
+
+// forall and exists are only keywords where a block can start -- first, or
+// straight after the . of the block before -- and only when names and a .
+// follow.  Anywhere else they are ordinary literals, so a formula like
+// "forall & exists" still means what it always did.
+static TokType quantifierAt(const Tokens &tokens, const Tokens::const_iterator it) {
+	const TokType type = quantifierName(tokens, it);
+	if (type == TT_Unknown) return type;
+	auto next = it + 1;
+	while (next != tokens.end() && next->isLiteral()) {
+		next++;
+	}
+	return next != tokens.end() && next->getType() == TT_Dot ? type : TT_Unknown;
+}
+
+// Splits the prefix off into blocks and the rest into body.
+// Returns an empty string or an error.
+static std::string parsePrefix(const Tokens &tokens, QuantBlocks &blocks, Tokens &body) {
+	auto it = tokens.begin();
+	TokType type = quantifierAt(tokens, it);
+	while (type != TT_Unknown) {
+		if (blocks.empty() || blocks.back().mType != type) {
+			blocks.push_back(QuantBlock(type));
+		}
+		// The names run up to the . that quantifierAt() found, and allow
+		// "forall a exists b . f" as well as "forall a . exists b . f"
+		for (it++; it->isLiteral() && quantifierName(tokens, it) == TT_Unknown; it++) {
+			blocks.back().mNames.push_back(it->getLiteral());
+		}
+		if (it->isLiteral()) {
+			type = quantifierName(tokens, it);
+		}
+		else {
+			type = quantifierAt(tokens, it + 1);
+			if (type != TT_Unknown) it++;
+		}
+	}
+
+	if (!blocks.empty()) {
+		if (it == tokens.end() || it->getType() != TT_Dot) {
+			return "Expected . after the quantified literals";
+		}
+		it++;
+	}
+
+	if (blocks.size() > 2) {
+		return "Only one quantifier alternation is supported";
+	}
+
+	for (auto rest = it; rest != tokens.end(); rest++) {
+		if (rest->getType() == TT_Dot) {
+			return "Unexpected " + rest->toString() + " -- quantifiers must all come first";
+		}
+	}
+
+	body.assign(it, tokens.end());
+	return "";
+}
+
+static std::string resolvePrefix(QuantBlocks &blocks, const LitNames &litnames, const WordDecls &words) {
+	std::vector<char> bound(litnames.size(), false);
+	const LitNameIndex indexes(litnames);
+
+	for (auto block = blocks.begin(); block != blocks.end(); block++) {
+		for (auto name = block->mNames.begin(); name != block->mNames.end(); name++) {
+			std::vector<int> lits;
+			const int idx = indexes.find(*name);
+			if (idx >= 0) lits.push_back(idx);
+			const int word = findWordDecl(words, *name);
+			if (word >= 0) {
+				for (int bit = 0; bit < words[word].mWidth; bit++) {
+					lits.push_back(words[word].mFirstLit + bit);
+				}
+			}
+
+			if (lits.empty()) return "Quantified literal " + *name + " does not appear in the formula";
+
+			for (auto lit = lits.begin(); lit != lits.end(); lit++) {
+				if (bound[*lit]) return *name + " is quantified more than once";
+				bound[*lit] = true;
+				block->mLits.push_back(*lit);
+			}
+		}
+	}
+
+	// Free literals are existential -- innermost if there is no exists block
+	const int n = (int)litnames.size();
+	QuantBlock *pExists = nullptr;
+	for (auto block = blocks.begin(); block != blocks.end(); block++) {
+		if (block->mType == TT_Exists) pExists = &*block;
+	}
+	if (pExists == nullptr) {
+		blocks.push_back(QuantBlock(TT_Exists));
+		pExists = &blocks.back();
+	}
+	for (int i = 0; i < n; i++) {
+		if (!bound[i]) pExists->mLits.push_back(i);
+	}
+
+	return "";
+}
+
+static std::string assignmentToString(const LitNames &names, const WordDecls &words, const std::vector<int> &lits, const LitValues &values) {
+	std::vector<char> shown(names.size(), false);
+	for (auto it = lits.begin(); it != lits.end(); it++) {
+		shown[*it] = true;
+	}
+
+	std::string out;
+	const int n = words.empty() ? (int)names.size() : words.front().mFirstLit;
+	for (int i = 0; i < n; i++) {
+		if (!shown[i]) continue;
+		if (!out.empty()) out += " ";
+		out += names[i] + "=" + boolToString(values.isTrue(i));
+	}
+
+	for (auto it = words.begin(); it != words.end(); it++) {
+		if (!shown[it->mFirstLit]) continue;
+		uint64_t value = 0;
+		for (int bit = 0; bit < it->mWidth; bit++) {
+			if (values.isTrue(it->mFirstLit + bit)) value |= (uint64_t)1 << bit;
+		}
+		if (!out.empty()) out += " ";
+		out += it->mName + "=" + std::to_string(value);
+	}
+	return out;
+}
+
+// Tseitin encodes cones of one ExprGraph into an incremental Solver as they
+// are needed.  Graph literal i is solver variable i, and a gate keeps the
+// variable it got for an earlier cone, so each new cone only costs the
+// gates it does not share with the ones before.
+class ConeEncoder {
+	Solver &mSolver;
+	std::vector<int> mNodeVars;	// By node, NO_NODE_VAR until encoded
+	std::vector<uint32_t> mStack;
+	std::vector<uint32_t> mNew;
+	Clauses mClauses;
+
+	enum { NO_NODE_VAR = -1, QUEUED = -2 };
+
+	Lit nodeLit(const ExprRef ref) const {
+		return mkLit(mNodeVars[exprNode(ref)], exprIsNegated(ref));
+	}
+
+public:
+	ConeEncoder(Solver &solver, const size_t nLits) : mSolver(solver) {
+		for (size_t i = 0; i < nLits; i++) {
+			mSolver.newVar();
+		}
+	}
+
+	// A solver literal that is true exactly when root is
+	Lit encode(const ExprGraph &graph, const ExprRef root) {
+		const ExprView nodes = graph.view();
+		if (mNodeVars.size() < nodes.size()) mNodeVars.resize(nodes.size(), NO_NODE_VAR);
+
+		mNew.clear();
+		mStack.assign(1, exprNode(root));
+		while (!mStack.empty()) {
+			const uint32_t i = mStack.back();
+			mStack.pop_back();
+			if (mNodeVars[i] != NO_NODE_VAR) continue;
+			mNodeVars[i] = QUEUED;
+			mNew.push_back(i);
+			if (nodes[i].mOp == EO_And || nodes[i].mOp == EO_Xor) {
+				mStack.push_back(exprNode(nodes[i].mA));
+				mStack.push_back(exprNode(nodes[i].mB));
+			}
+		}
+
+		// Children before parents
+		std::sort(mNew.begin(), mNew.end());
+		for (auto it = mNew.begin(); it != mNew.end(); it++) {
+			const ExprNode &node = nodes[*it];
+			if (node.mOp == EO_Var) {
+				mNodeVars[*it] = (int)node.mA;
+				continue;
+			}
+
+			const Lit g = mkLit(mNodeVars[*it] = mSolver.newVar(), false);
+			if (node.mOp == EO_Const) {
+				mClauses.push_back(Clause(1, litNot(g)));
+			}
+			else {
+				addGateClauses((ExprOp)node.mOp, g, nodeLit(node.mA), nodeLit(node.mB), mClauses);
+			}
+		}
+		for (auto it = mClauses.begin(); it != mClauses.end(); it++) {
+			mSolver.addClause(*it);
+		}
+		mClauses.clear();
+		return nodeLit(root);
+	}
+};
+
+// E outer A inner matrix.  On success witness holds the outer literals.
+// Each side keeps one Solver for the whole run: the candidate side gets one
+// more copy of the matrix per counterexample, and the verification side
+// has ~matrix from the start and takes each candidate as assumptions, so
+// neither throws away what it has learned.
+static bool solveExistsForall(ExprGraph &graph, const ExprRef matrix, const std::vector<int> &outer,
+		const std::vector<int> &inner, const size_t nLits, LitValues &witness, long &iterations) {
+	std::vector<ExprRef> keep(nLits);
+	for (size_t i = 0; i < nLits; i++) {
+		keep[i] = graph.mkVar((int)i);
+	}
+
+	Clauses none;
+	Solver candidates(0, none);
+	ConeEncoder candidateCones(candidates, nLits);
+	Solver verifier(0, none);
+	ConeEncoder verifierCones(verifier, nLits);
+	Clause c(1, verifierCones.encode(graph, exprNot(matrix)));
+	verifier.addClause(c);
+
+	std::vector<Lit> candidate;
+	for (;;) {
+		iterations++;
+
+		if (!candidates.solve()) {
+			return false;
+		}
+
+		candidate.clear();
+		for (auto it = outer.begin(); it != outer.end(); it++) {
+			candidate.push_back(mkLit(*it, !candidates.isTrue(*it)));
+		}
+		if (!verifier.solve(candidate)) {
+			witness = LitValues(nLits);
+			for (auto it = outer.begin(); it != outer.end(); it++) {
+				witness.set(*it, candidates.isTrue(*it));
+			}
+			return true;
+		}
+
+		std::vector<ExprRef> fixInner = keep;
+		for (auto it = inner.begin(); it != inner.end(); it++) {
+			fixInner[*it] = verifier.isTrue(*it) ? EXPR_TRUE : EXPR_FALSE;
+		}
+		c.assign(1, candidateCones.encode(graph, graph.substitute(matrix, fixInner)));
+		candidates.addClause(c);
+	}
+}
+
+// blocks is exactly two blocks, one of each, after resolvePrefix()
+static void solveQuantifiedMain(ExprGraph &graph, const ExprRef root, const QuantBlocks &blocks,
+		const LitNames &litnames, const WordDecls &words) {
+	const QuantBlock &outer = blocks[0];
+	const QuantBlock &inner = blocks[1];
+	const bool existsFirst = outer.mType == TT_Exists;
+
+	LitValues witness;
+	long iterations = 0;
+	const ExprRef matrix = existsFirst ? root : exprNot(root);
+	const bool found = solveExistsForall(graph, matrix, outer.mLits, inner.mLits, litnames.size(), witness, iterations);
+	const bool satisfied = existsFirst ? found : !found;
+
+	if (existsFirst && found) {
+		std::cout << "Satisfied with " << assignmentToString(litnames, words, outer.mLits, witness) << std::endl;
+	}
+	else if (!existsFirst && found) {
+		std::cout << "Unstatisfied -- counterexample " << assignmentToString(litnames, words, outer.mLits, witness) << std::endl;
+	}
+	else if (!existsFirst) {
+		std::cout << "Satisfied for every assignment of the universal literals" << std::endl;
+	}
+	else {
+		std::cout << "Unstatisfied" << std::endl;
+	}
+
+	std::cout << "        Conflicts: " << prettyNumber(gnConflicts) << std::endl;
+	std::cout << " CEGAR Iterations: " << prettyNumber(iterations) << std::endl;
+	exit(satisfied ? EXIT_SATISFIABLE : EXIT_UNSATISFIABLE);
+}
+
+//-----------------------------------------------------------------------------
+// Compiled Formulas
+// "rsolver --compile in.txt -o in.rsb" saves the literal names, words,
+// quantifiers and the expression DAG so "rsolver in.rsb" can mmap it and
+// start solving without tokenizing or looking up a single name.
+//
+//   RsbHeader
+//   ExprNode  nodes[mnNodes]       -- used in place, straight from the map
+//   RsbWord   words[mnWords]
+//   uint32_t  blocks[mnBlockWords] -- per block: type, count, literals...
+//   char      names[mnNameBytes]   -- NUL terminated literals then words
+
+static const char RSB_MAGIC[4] = { 'R', 'S', 'B', 'F' };
+enum { RSB_VERSION = 1, RSB_BYTE_ORDER = 0x01020304 };
+
+class RsbHeader {
+public:
+	char mMagic[4];
+	uint32_t mVersion;
+	uint32_t mByteOrder;
+	uint32_t mnLits;
+	uint32_t mnWords;
+	uint32_t mnBlockWords;
+	uint32_t mnNodes;
+	uint32_t mRoot;
+	uint32_t mnNameBytes;
+};
+
+class RsbWord {
+public:
+	uint32_t mNameOffset;
+	uint32_t mWidth;
+	uint32_t mFirstLit;
+};
+
+class Formula {
+public:
+	LitNames mLitNames;
+	WordDecls mWords;
+	QuantBlocks mBlocks;
+	ExprGraph mGraph;
+	ExprView mMapped;	// Nodes in a compiled file, used instead of mGraph
+	ExprRef mRoot;
+	std::vector<Lit> mAssumptions;	// Literal index and sign, and-ed onto mRoot
+
+	Formula() {
+		mRoot = EXPR_FALSE;
+	}
+
+	bool isMapped() const { return mMapped.mpNodes != nullptr; }
+
+	ExprView getView() const {
+		return isMapped() ? mMapped : mGraph.view();
+	}
+
+	// For when we need to add nodes -- copies the mapped nodes if need be
+	ExprGraph &getGraph() {
+		if (isMapped()) {
+			mGraph = ExprGraph(mMapped);
+			mMapped = ExprView();
+		}
+		return mGraph;
+	}
+};
+
+static bool isCompiledFileName(const std::string &path) {
+	return path.size() > 4 && path.compare(path.size() - 4, 4, ".rsb") == 0;
+}
+
+// Returns an empty string or an error
+static std::string writeCompiled(const Formula &formula, const std::string &path) {
+	std::string names;
+	std::vector<RsbWord> words;
+	std::vector<uint32_t> blocks;
+
+	for (auto it = formula.mLitNames.begin(); it != formula.mLitNames.end(); it++) {
+		names += *it;
+		names += '\0';
+	}
+	for (auto it = formula.mWords.begin(); it != formula.mWords.end(); it++) {
+		RsbWord word;
+		word.mNameOffset = (uint32_t)names.size();
+		word.mWidth = it->mWidth;
+		word.mFirstLit = it->mFirstLit;
+		words.push_back(word);
+		names += it->mName;
+		names += '\0';
+	}
+	for (auto it = formula.mBlocks.begin(); it != formula.mBlocks.end(); it++) {
+		blocks.push_back(it->mType == TT_Forall ? 0 : 1);
+		blocks.push_back((uint32_t)it->mLits.size());
+		blocks.insert(blocks.end(), it->mLits.begin(), it->mLits.end());
+	}
+
+	const ExprView nodes = formula.getView();
+	RsbHeader header;
+	memcpy(header.mMagic, RSB_MAGIC, sizeof(header.mMagic));
+	header.mVersion = RSB_VERSION;
+	header.mByteOrder = RSB_BYTE_ORDER;
+	header.mnLits = (uint32_t)formula.mLitNames.size();
+	header.mnWords = (uint32_t)words.size();
+	header.mnBlockWords = (uint32_t)blocks.size();
+	header.mnNodes = (uint32_t)nodes.size();
+	header.mRoot = formula.mRoot;
+	header.mnNameBytes = (uint32_t)names.size();
+
+	FILE *f = fopen(path.c_str(), "wb");
+	if (f == nullptr) {
+		return "Cannot write " + path + " -- " + strerror(errno);
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	ok = ok && fwrite(nodes.mpNodes, sizeof(ExprNode), nodes.size(), f) == nodes.size();
+	ok = ok && fwrite(words.data(), sizeof(RsbWord), words.size(), f) == words.size();
+	ok = ok && fwrite(blocks.data(), sizeof(uint32_t), blocks.size(), f) == blocks.size();
+	ok = ok && fwrite(names.data(), 1, names.size(), f) == names.size();
+	ok = (fclose(f) == 0) && ok;
+
+	return ok ? "" : "Cannot write " + path;
+}
+
+// Checks what the solver relies on: children come before their parents and
+// literals are in range.  One pass, and much cheaper than parsing.
+static bool validNodes(const ExprView &nodes, const uint32_t nLits, const uint32_t root) {
+	if (nodes.size() == 0 || nodes[0].mOp != EO_Const || exprNode(root) >= nodes.size()) return false;
+	for (uint32_t i = 1; i < nodes.size(); i++) {
+		const ExprNode &node = nodes[i];
+		if (node.mOp == EO_Var) {
+			if (node.mA >= nLits) return false;
+		}
+		else if (node.mOp == EO_And || node.mOp == EO_Xor) {
+			if (exprNode(node.mA) >= i || exprNode(node.mB) >= i) return false;
+		}
+		else {
+			return false;
+		}
+	}
+	return true;
+}
+
+// The map stays in place until we exit.  Returns an empty string or an error.
+static std::string mapCompiled(const std::string &path, Formula &formula) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return "Cannot open " + path + " -- " + strerror(errno);
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RsbHeader)) {
+		close(fd);
+		return path + " is not a compiled formula";
+	}
+
+	const size_t size = st.st_size;
+	void *pMap = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (pMap == MAP_FAILED) {
+		return "Cannot map " + path + " -- " + strerror(errno);
+	}
+
+	const char *pBase = (const char *)pMap;
+	const RsbHeader *pHeader = (const RsbHeader *)pBase;
+	if (memcmp(pHeader->mMagic, RSB_MAGIC, sizeof(RSB_MAGIC)) != 0 || pHeader->mByteOrder != RSB_BYTE_ORDER) {
+		return path + " is not a compiled formula";
+	}
+	if (pHeader->mVersion != RSB_VERSION) {
+		return path + " was compiled by a different version -- recompile it";
+	}
+
+	const size_t nodesAt = sizeof(RsbHeader);
+	const size_t wordsAt = nodesAt + (size_t)pHeader->mnNodes * sizeof(ExprNode);
+	const size_t blocksAt = wordsAt + (size_t)pHeader->mnWords * sizeof(RsbWord);
+	const size_t namesAt = blocksAt + (size_t)pHeader->mnBlockWords * sizeof(uint32_t);
+	if (namesAt + pHeader->mnNameBytes != size) {
+		return path + " is truncated or corrupt";
+	}
+
+	const ExprView nodes((const ExprNode *)(pBase + nodesAt), pHeader->mnNodes);
+	if (!validNodes(nodes, pHeader->mnLits, pHeader->mRoot)) {
+		return path + " is corrupt";
+	}
+
+	const char *pNames = pBase + namesAt;
+	const char *pNamesEnd = pNames + pHeader->mnNameBytes;
+	if (pHeader->mnNameBytes > 0 && pNamesEnd[-1] != '\0') {
+		return path + " is corrupt";
+	}
+
+	const char *pName = pNames;
+	for (uint32_t i = 0; i < pHeader->mnLits; i++) {
+		if (pName >= pNamesEnd) return path + " is corrupt";
+		formula.mLitNames.push_back(pName);
+		pName += strlen(pName) + 1;
+	}
+
+	const RsbWord *pWords = (const RsbWord *)(pBase + wordsAt);
+	for (uint32_t i = 0; i < pHeader->mnWords; i++) {
+		if (pWords[i].mNameOffset >= pHeader->mnNameBytes || pWords[i].mFirstLit + pWords[i].mWidth > pHeader->mnLits) {
+			return path + " is corrupt";
+		}
+		WordDecl decl(pNames + pWords[i].mNameOffset, pWords[i].mWidth);
+		decl.mFirstLit = pWords[i].mFirstLit;
+		formula.mWords.push_back(decl);
+	}
+
+	const uint32_t *pBlocks = (const uint32_t *)(pBase + blocksAt);
+	for (uint32_t i = 0; i + 2 <= pHeader->mnBlockWords; ) {
+		QuantBlock block(pBlocks[i] == 0 ? TT_Forall : TT_Exists);
+		const uint32_t count = pBlocks[i + 1];
+		i += 2;
+		if (count > pHeader->mnBlockWords - i) return path + " is corrupt";
+		for (uint32_t k = 0; k < count; k++, i++) {
+			if (pBlocks[i] >= pHeader->mnLits) return path + " is corrupt";
+			block.mLits.push_back(pBlocks[i]);
+		}
+		formula.mBlocks.push_back(block);
+	}
+
+	formula.mMapped = nodes;
+	formula.mRoot = pHeader->mRoot;
+	return "";
+}
+
+// Extra arguments after a compiled file are assumptions: name or ~name.
+// They are kept apart from the mapped nodes, which would otherwise have to
+// be copied into a graph to and them on, and go to the solver as units.
+// Returns an empty string or an error.
+static std::string addAssumptions(Formula &formula, const int argc, char *argv[], const int first) {
+	if (first >= argc) return "";
+	const LitNameIndex indexes(formula.mLitNames);
+	for (int i = first; i < argc; i++) {
+		const bool negated = argv[i][0] == '~';
+		const char *pName = negated ? argv[i] + 1 : argv[i];
+		const int idx = indexes.find(pName);
+		if (idx < 0) {
+			return std::string("Unknown literal in assumption ") + argv[i];
+		}
+		formula.mAssumptions.push_back(mkLit(idx, negated));
+	}
+	return "";
+}
+
+//-----------------------------------------------------------------------------
+// Solve Main
+
+// Exits if there is a problem
+static void compileFormula(const Tokens &input, Formula &formula) {
+	Tokens tokens;
+	const std::string prefixError = parsePrefix(input, formula.mBlocks, tokens);
+
+	LitNames &litnames = formula.mLitNames;
+	WordDecls &words = formula.mWords;
+	getLitNames(tokens, litnames);
+	assignLiteralIndexes(tokens, litnames);
+	std::string wordError = getWordDecls(tokens, words, litnames);
+	if (wordError.empty()) wordError = prefixError;
+	if (wordError.empty() && !formula.mBlocks.empty()) wordError = resolvePrefix(formula.mBlocks, litnames, words);
+
+	//
+	// Compile once, which also checks the syntax
+	//
+
+	Compiler compiler(tokens, words, formula.mGraph);
+	const ParseResult parsed = wordError.empty() ? compiler.compile() : ParseResult();
+	if (!wordError.empty() || parsed.isError()) {
+		std::cerr << "Formula has invalid syntax -- " << (wordError.empty() ? parsed.getError() : wordError) << std::endl;
+		exit(EXIT_CANNOT_PARSE_INPUT);
+		return;
+	}
+
+	if (litnames.size() == 0) {
+		std::cerr << "There are no literals -- nothing to solve" << std::endl;
+		exit(EXIT_CANNOT_PARSE_INPUT);
+	}
+
+	formula.mRoot = parsed.getRef();
+}
+
+static void solveFormula(Formula &formula) {
+	const LitNames &litnames = formula.mLitNames;
+	printLitNames(litnames);
+
+	if (formula.mBlocks.size() > 1) {
+		// The refinement builds new nodes anyway, so the assumptions join the root
+		ExprGraph &graph = formula.getGraph();
+		ExprRef root = formula.mRoot;
+		for (auto it = formula.mAssumptions.begin(); it != formula.mAssumptions.end(); it++) {
+			const ExprRef lit = graph.mkVar(litVar(*it));
+			root = graph.mkAnd(root, litNegated(*it) ? exprNot(lit) : lit);
+		}
+		solveQuantifiedMain(graph, root, formula.mBlocks, litnames, formula.mWords);
+		return;
+	}
+
+	//
+	// Now solve
+	//
+
+	WorkingValues literals(&litnames, &formula.mWords);
+	Evaluator evaluator(formula.getView(), formula.mRoot);
+	const SolveResult solveResult = solve(formula.getView(), formula.mRoot, formula.mAssumptions, literals);
+	bool modelOk = true;
+	if (solveResult.isSatisfied()) {
+		modelOk = evaluator.eval(solveResult.mLiterals);
+		for (auto it = formula.mAssumptions.begin(); it != formula.mAssumptions.end() && modelOk; it++) {
+			modelOk = solveResult.mLiterals.getBool(litVar(*it)) != litNegated(*it);
+		}
+	}
+	if (!modelOk) {
+		std::cerr << "Internal error -- the model does not satisfy the formula" << std::endl;
+		exit(EXIT_INTERNAL_ERROR);
+	}
+	std::cout << solveResult.toString() << std::endl;
+	std::cout << "        Conflicts: " << prettyNumber(gnConflicts) << std::endl;
+	std::cout << "        Decisions: " << prettyNumber(gnDecisions) << std::endl;
+	std::cout << "     Propagations: " << prettyNumber(gnPropagations) << std::endl;
+	std::cout << "         Restarts: " << prettyNumber(gnRestarts) << std::endl;
+	std::cout << "  Deleted Clauses: " << prettyNumber(gnDeletedClauses) << std::endl;
+	std::cout << "     Learned Lits: " << prettyNumber(gnLearntLits) << std::endl;
+	std::cout << "   Minimized Lits: " << prettyNumber(gnMinimizedLits) << std::endl;
+	std::cout << "Chrono Backtracks: " << prettyNumber(gnChronoBacktracks) << std::endl;
+	std::cout << "  Eliminated Vars: " << prettyNumber(gnEliminatedVars) << std::endl;
+	std::cout << " Subsumed Clauses: " << prettyNumber(gnSubsumedClauses) << std::endl;
+	std::cout << "Strengthened Lits: " << prettyNumber(gnStrengthenedLits) << std::endl;
+	std::cout << "  Equivalent Vars: " << prettyNumber(gnEquivalentVars) << std::endl;
+	std::cout << "      Failed Lits: " << prettyNumber(gnFailedLits) << std::endl;
+	std::cout << "   Necessary Lits: " << prettyNumber(gnNecessaryLits) << std::endl;
+	std::cout << "    Vivified Lits: " << prettyNumber(gnVivifiedLits) << std::endl;
+	std::cout << "       Added Vars: " << prettyNumber(gnAddedVars) << std::endl;
+	std::cout << "       Symmetries: " << prettyNumber(gnSymmetries) << std::endl;
+	std::cout << "     2-SAT Solves: " << prettyNumber(gnTwoSatSolves) << std::endl;
+	
+	if (solveResult.isError()) {
+		exit(EXIT_CANNOT_PARSE_INPUT);
+	}
+	else {
+		if (solveResult.isSatisfied()) {
+			exit(EXIT_SATISFIABLE);
+		}
+		else {
+			exit(EXIT_UNSATISFIABLE);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Main
 
 static void parseAndSolveLine(const std::string &line) {
 	if (line.empty()) {
@@ -698,21 +5632,136 @@ static void parseAndSolveLine(const std::string &line) {
 	}
 
 	std::cout << "Parsed Input: " << tokensToString(tokens) << std::endl;
-	solveMain(tokens);
+	Formula formula;
+	compileFormula(tokens, formula);
+	solveFormula(formula);
 }
 
 static void parseAndSolveFile(FILE *f) {
 	parseAndSolveLine(readFile(f));
 }
 
+static void compileToFile(const std::string &inPath, const std::string &outPath) {
+	FILE *f = fopen(inPath.c_str(), "r");
+	if (f == nullptr) {
+		std::cerr << "Cannot read " << inPath << " -- " << strerror(errno) << std::endl;
+		exit(EXIT_CANNOT_READ_INPUT);
+	}
+	const std::string line = readFile(f);
+	fclose(f);
+
+	const Tokens tokens = parseLine(line);
+	if (tokens.size() == 0) {
+		std::cerr << "No tokens found -- cannot compile" << std::endl;
+		exit(EXIT_CANNOT_PARSE_INPUT);
+	}
+
+	Formula formula;
+	compileFormula(tokens, formula);
+	const std::string error = writeCompiled(formula, outPath);
+	if (!error.empty()) {
+		std::cerr << error << std::endl;
+		exit(EXIT_CANNOT_READ_INPUT);
+	}
+
+	std::cout << "Compiled " << prettyNumber(formula.mLitNames.size()) << " literals and "
+		<< prettyNumber(formula.getView().size()) << " nodes to " << outPath << std::endl;
+	exit(0);
+}
+
+static void solveCompiledFile(const std::string &path, const int argc, char *argv[], const int firstAssumption) {
+	Formula formula;
+	std::string error = mapCompiled(path, formula);
+	if (!error.empty()) {
+		std::cerr << error << std::endl;
+		exit(EXIT_CANNOT_READ_INPUT);
+	}
+
+	error = addAssumptions(formula, argc, argv, firstAssumption);
+	if (!error.empty()) {
+		std::cerr << error << std::endl;
+		exit(EXIT_CANNOT_PARSE_INPUT);
+	}
+
+	solveFormula(formula);
+}
+
 int main(int argc, char *argv[]) {
-	if (argc > 1) {
-		if (strcmp(argv[1], "-?") == 0) {
+	static const struct option longOptions[] = {
+		{ "compile", required_argument, nullptr, 'c' },
+		{ "decide", required_argument, nullptr, 'd' },
+		{ "restart", required_argument, nullptr, 'r' },
+		{ "chrono", required_argument, nullptr, 'C' },
+		{ "elim", required_argument, nullptr, 'E' },
+		{ "threads", required_argument, nullptr, 'j' },
+		{ "output", required_argument, nullptr, 'o' },
+		{ nullptr, 0, nullptr, 0 }
+	};
+
+	std::string compilePath;
+	std::string outPath;
+	uint64_t chronoLevels;
+	uint64_t elimOccurrences;
+	uint64_t threads;
+	int opt;
+
+	// + stops at the formula, so a word expression like "x - 1" is left alone
+	opterr = 0;
+	while ((opt = getopt_long(argc, argv, "+d:j:o:r:", longOptions, nullptr)) != -1) {
+		switch (opt) {
+		case 'c':
+			compilePath = optarg;
+			break;
+		case 'C':
+			if (!parseNumber(optarg, chronoLevels) || chronoLevels > INT32_MAX) {
+				usage();
+			}
+			gChronoLevels = (int)chronoLevels;
+			break;
+		case 'E':
+			if (!parseNumber(optarg, elimOccurrences) || elimOccurrences > INT32_MAX) {
+				usage();
+			}
+			gElimOccurrences = (int)elimOccurrences;
+			break;
+		case 'd':
+			if (!parseHeuristic(optarg, gHeuristic)) {
+				usage();
+			}
+			break;
+		case 'j':
+			if (!parseNumber(optarg, threads) || threads < 1 || threads > 1024) {
+				usage();
+			}
+			gThreads = (int)threads;
+			break;
+		case 'o':
+			outPath = optarg;
+			break;
+		case 'r':
+			if (!parseRestartPolicy(optarg, gRestartPolicy)) {
+				usage();
+			}
+			break;
+		default:
 			usage();
 			return 0;
 		}
+	}
+
+	if (!compilePath.empty()) {
+		if (optind != argc || outPath.empty()) {
+			usage();
+		}
+		compileToFile(compilePath, outPath);
+	}
+
+	if (optind < argc && isCompiledFileName(argv[optind])) {
+		solveCompiledFile(argv[optind], argc, argv, optind + 1);
+	}
 
-		parseAndSolveLine(flatten(argc, argv, 1));
+	if (optind < argc) {
+		parseAndSolveLine(flatten(argc, argv, optind));
 	}
 
 	parseAndSolveFile(stdin);